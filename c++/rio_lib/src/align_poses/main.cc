@@ -1,35 +1,89 @@
+#include <rio_lib/batch.h>
+#include <rio_lib/frame_config.h>
+#include <rio_lib/log.h>
 #include <rio_lib/rio_config.h>
 #include <rio_lib/rio.h>
-#include <sys/stat.h>
-#include <fstream>
+#include <rio_lib/thread_pool.h>
+#include <rio_lib/trajectory.h>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <sstream>
 
+void PrintUsage() {
+    std::cout << "usage: align_poses <data_path> <scan_id>[,<scan_id>...]|<scan_list> [output_folder]"
+              << " [--format frames|text|binary] [--threads N]" << std::endl;
+}
+
+// Writes the camera poses of one or many scans aligned to their reference, e.g.
+// align_poses data_path train_scans.txt sequence --format binary
+// The poses of a scan are loaded and aligned at once. With --format frames (default)
+// one frame-xxxxxx.align.pose.txt is written per frame by a pool of writers, text and
+// binary write one trajectory file per scan into data_path/scan_id/output_folder.
 int main(int argc, char **argv){
-    if (argc < 3)
+    std::vector<std::string> arguments;
+    RIO::TrajectoryFormat format = RIO::TrajectoryFormat::Frames;
+    unsigned num_threads = 0;
+    for (int i = 1; i < argc; i++) {
+        const std::string argument{argv[i]};
+        if (argument == "--format" && i + 1 < argc) {
+            if (!RIO::ParseTrajectoryFormat(argv[++i], format)) {
+                PrintUsage();
+                return 1;
+            }
+        } else if (argument == "--threads" && i + 1 < argc) {
+            num_threads = std::stoi(argv[++i]);
+        } else {
+            arguments.push_back(argument);
+        }
+    }
+    if (arguments.size() < 2) {
+        PrintUsage();
         return 0;
-    const std::string data_path{argv[1]};
-    const std::string scan_id{argv[2]};
-    const std::string output_folder = (argc == 4) ? argv[3] : "sequence";
-    RIO::RIOConfig config(data_path);
-    RIO::RIO rio(config);
+    }
+    const std::string data_path{arguments[0]};
+    const std::string output_folder = (arguments.size() > 2) ? arguments[2] : "sequence";
+    std::vector<std::string> scan_ids;
+    if (!RIO::ReadScanList(arguments[1], scan_ids)) {
+        std::stringstream list(arguments[1]);
+        std::string scan_id{""};
+        while (std::getline(list, scan_id, ','))
+            scan_ids.push_back(scan_id);
+    }
+    const RIO::RIOConfig config(data_path);
+    const FrameConfig frame_config(data_path);
+    const RIO::RIO rio(config);
 
-    size_t frame_id = 0;
-    bool state;
-    bool mm = false;
-    while (true) {
-        Eigen::Matrix4f pose_normalized;
-        state = rio.GetCameraPose(pose_normalized, scan_id, frame_id, true, mm);
-        if (!state) break;
-        std::stringstream filename;
-        const std::string pose_subfix = ".align.pose.txt";
-        filename << data_path << "/" << scan_id << "/" << output_folder << "/"
-                 << "frame-" << std::setfill('0') << std::setw(6) << frame_id << pose_subfix;
-        std::fstream f(filename.str(), std::ios::out);
-        if (!f) throw std::system_error(errno, std::system_category(), "failed to open "+filename.str());
-        f << pose_normalized;
-        f.close();
-        frame_id++;
+    constexpr int frames_per_task = 64;
+    RIO::ThreadPool pool(num_threads);
+    std::atomic<size_t> failed{0};
+    for (const std::string& scan_id: scan_ids) {
+        pool.Submit([&, scan_id]() {
+            const std::string folder = data_path + "/" + scan_id + "/" + output_folder;
+            const auto poses = std::make_shared<Eigen::Matrix4Xf>();
+            const int frames = rio.GetCameraPoses(scan_id, *poses, true, false);
+            if (frames <= 0) {
+                failed++;
+                RIO_LOG(Error) << "no camera poses for " << scan_id;
+                return;
+            }
+            if (format == RIO::TrajectoryFormat::Frames) {
+                for (int begin = 0; begin < frames; begin += frames_per_task) {
+                    pool.Submit([&, folder, poses, begin, frames]() {
+                        const int end = std::min(frames, begin + frames_per_task);
+                        if (!RIO::SavePoses(folder, frame_config.frame_prefix, *poses, begin, end))
+                            failed++;
+                    });
+                }
+            } else if (!RIO::SaveTrajectory(folder + "/" + RIO::TrajectoryFilename(format), *poses, format)) {
+                failed++;
+            }
+            RIO_LOG(Info) << "aligned " << frames << " poses, saving in " << folder;
+        });
     }
-    std::cout << "saved " << frame_id << " poses, ";
-    std::cout << "in " << data_path << "/" << scan_id << "/" << output_folder << std::endl;
-    return 0;
-}
\ No newline at end of file
+    pool.Wait();
+    RIO::FlushLog();
+    if (failed > 0)
+        std::cout << failed << " scans or writes failed" << std::endl;
+    return (failed == 0) ? 0 : 1;
+}
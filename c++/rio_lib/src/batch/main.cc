@@ -0,0 +1,79 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <rio_lib/batch.h>
+#include <rio_lib/log.h>
+#include <rio_lib/rio_config.h>
+#include <rio_lib/rio.h>
+
+void PrintUsage() {
+    std::cout << "usage: rio_batch <data_path> <scan_list> <operation>[,<operation>...] [num_threads]"
+              << " [--shard i/N] [--journal <folder>]" << std::endl
+              << "       rio_batch --merge <folder> <N>" << std::endl
+              << "operations: Transform2Reference, RemapLabelsPly, ReSavePLYASCII, AlignPoses, Backproject" << std::endl;
+}
+
+// Runs operations on all scans of a scan list (e.g. a split file), for example:
+// rio_batch data_path train_scans.txt Transform2Reference,RemapLabelsPly,AlignPoses 8
+// Several processes (sharing a filesystem) split the work with --shard 0/4 ... --shard 3/4,
+// with --journal an interrupted run continues where it stopped.
+int main(int argc, char **argv) {
+    std::vector<std::string> arguments;
+    RIO::BatchOptions options;
+    for (int i = 1; i < argc; i++) {
+        const std::string argument{argv[i]};
+        if (argument == "--merge" && i + 2 < argc) {
+            const std::string folder{argv[i + 1]};
+            const bool merged = RIO::MergeJournals(folder, std::stoi(argv[i + 2]));
+            RIO::FlushLog();
+            std::cout << (merged ? "merged journals in " : "can not merge journals in ") << folder << std::endl;
+            return merged ? 0 : 1;
+        } else if (argument == "--shard" && i + 1 < argc) {
+            if (!RIO::ParseShard(argv[++i], options.shard, options.num_shards)) {
+                PrintUsage();
+                return 1;
+            }
+        } else if (argument == "--journal" && i + 1 < argc) {
+            options.journal_folder = argv[++i];
+        } else {
+            arguments.push_back(argument);
+        }
+    }
+    if (arguments.size() < 3) {
+        PrintUsage();
+        return 0;
+    }
+    const std::string data_path{arguments[0]};
+    std::vector<std::string> scan_ids;
+    if (!RIO::ReadScanList(arguments[1], scan_ids)) {
+        std::cout << "can not read scan list " << arguments[1] << std::endl;
+        return 1;
+    }
+    std::stringstream operations(arguments[2]);
+    std::string name{""};
+    while (std::getline(operations, name, ',')) {
+        RIO::BatchOperation operation;
+        if (!RIO::ParseBatchOperation(name, operation)) {
+            std::cout << "unknown operation " << name << std::endl;
+            return 1;
+        }
+        options.operations.push_back(operation);
+    }
+    if (arguments.size() > 3)
+        options.num_threads = std::stoi(arguments[3]);
+    const RIO::RIOConfig config(data_path);
+    // All scans share the metadata (3RScan.json, objects.json) of one RIO instance.
+    const RIO::RIO rio(config);
+    const RIO::Batch batch(rio, config);
+    const RIO::BatchStats stats = batch.Run(scan_ids, options);
+    stats.Print(std::cout);
+    return (stats.failed == 0) ? 0 : 1;
+}
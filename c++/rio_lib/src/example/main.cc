@@ -8,6 +8,7 @@
  ********************************************************/
 
 #include <iostream>
+#include <rio_lib/log.h>
 #include <rio_lib/rio_config.h>
 #include <rio_lib/rio.h>
 
@@ -24,21 +25,37 @@ int main(int argc, char **argv) {
     const bool is_reference = rio.IsReference(scan_id);
     // get reference scan id for a given rescan id
     const std::string reference_id = rio.GetReference(scan_id);
+    // get all rescans of the reference (without a linear search over all scans)
+    const std::vector<std::string> rescans = rio.GetRescans(is_reference ? scan_id : reference_id);
+    RIO_LOG(Info) << rescans.size() << " rescans of the reference";
+    // the workspace keeps the parsed ply columns allocated between calls.
+    RIO::PlyWorkspace workspace;
     // transforms *.obj and *.ply to be aligned to the reference.
     if (is_rescan)
-        rio.Transform2Reference(scan_id);
+        rio.Transform2Reference(scan_id, workspace);
     // saves ply with remaped local instance id "objectId" to global ID globalId.
-    rio.RemapLabelsPly(scan_id);
-    // Prints semantic labels:
+    rio.RemapLabelsPly(scan_id, workspace);
+    // Finds all scans with a chair without iterating over the scans.
+    const RIO::ObjectPostings chairs = rio.object_index().Find("chair");
+    RIO_LOG(Info) << chairs.size() << " chairs in " << rio.object_index().scan_ids().size() << " scans";
+    // Prints semantic labels (after the queued log messages):
     rio.PrintSemanticLabels(scan_id);
     // Transforms Instance 10 to the reference given the ground truth transformation.
     if (argc > 3)
-        rio.TransformInstance(scan_id, std::stoi(argv[3]));
+        rio.TransformInstance(scan_id, std::stoi(argv[3]), workspace);
+    // Transforms all instances of a rescan to the reference in one pass (writes one file per instance).
+    // if (is_rescan)
+    //     rio.TransformAllInstances(scan_id, RIO::InstanceExportOptions(), workspace);
+    workspace.Report(std::cout);
+    // all calls above parse the labels ply of the scan only once.
+    RIO_LOG(Info) << "geometry cache: " << rio.geometry_cache().hits() << " hits, "
+                  << rio.geometry_cache().misses() << " misses";
     // Return the camera pose
     const Eigen::Matrix4f& pose = rio.GetCameraPose(scan_id, 0, false);
     const Eigen::Matrix4f& pose_normalized = rio.GetCameraPose(scan_id, 0, true);
-    std::cout << pose << std::endl << std::endl << pose_normalized << std::endl;
+    RIO_LOG(Info) << "camera pose:\n" << pose << "\n\n" << pose_normalized;
     // Backproject depth image and color
     rio.Backproject(scan_id, 28, true);
+    RIO::FlushLog();
     return 0;
 }
@@ -0,0 +1,483 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#include "rio_lib/batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <sys/stat.h>
+
+#include "rio_lib/hash.h"
+#include "rio_lib/log.h"
+#include "rio_lib/output_cache.h"
+#include "rio_lib/ply_workspace.h"
+#include "rio_lib/thread_pool.h"
+#include "rio_lib/trajectory.h"
+
+namespace RIO {
+
+namespace {
+
+// Approximate size of a pose file in bytes.
+constexpr size_t kPoseBytes = 128;
+// Sharding weight of one frame relative to one mesh vertex.
+constexpr size_t kFrameWeight = 1000;
+
+const size_t FileSize(const std::string& filename) {
+    struct stat buffer;
+    return (stat(filename.c_str(), &buffer) == 0) ? static_cast<size_t>(buffer.st_size) : 0;
+}
+
+const bool IsFrameOperation(const BatchOperation operation) {
+    return operation == BatchOperation::AlignPoses || operation == BatchOperation::Backproject;
+}
+
+// Number of vertices in the header of a ply file (0 if it can not be read).
+const size_t PlyVertexCount(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    std::string line{""};
+    while (std::getline(file, line) && line.rfind("end_header", 0) != 0) {
+        std::istringstream element(line);
+        std::string keyword{""}, name{""};
+        size_t count = 0;
+        if ((element >> keyword >> name >> count) && keyword == "element" && name == "vertex")
+            return count;
+    }
+    return 0;
+}
+
+// One (scan, operation) pair of a batch run.
+struct BatchJob {
+    std::string scan_id;
+    BatchOperation operation;
+    int frames;
+    size_t cost;
+};
+
+// Wraps a task of a batch. An exception counts the task as failed instead of
+// terminating the process.
+std::function<void()> CatchFailures(const std::string& name, std::atomic<size_t>& failed,
+                                    std::function<void()> task) {
+    return [name, &failed, task]() {
+        try {
+            task();
+        } catch (const std::exception& e) {
+            RIO_LOG(Error) << name << " failed: " << e.what();
+            failed++;
+        } catch (...) {
+            RIO_LOG(Error) << name << " failed";
+            failed++;
+        }
+    };
+}
+
+}  // namespace
+
+const std::string BatchOperationName(const BatchOperation operation) {
+    switch (operation) {
+        case BatchOperation::Transform2Reference: return "Transform2Reference";
+        case BatchOperation::RemapLabelsPly: return "RemapLabelsPly";
+        case BatchOperation::ReSavePLYASCII: return "ReSavePLYASCII";
+        case BatchOperation::AlignPoses: return "AlignPoses";
+        case BatchOperation::Backproject: return "Backproject";
+    }
+    return "";
+}
+
+const bool ParseBatchOperation(const std::string& name, BatchOperation& operation) {
+    for (const BatchOperation candidate: { BatchOperation::Transform2Reference, BatchOperation::RemapLabelsPly,
+                                           BatchOperation::ReSavePLYASCII, BatchOperation::AlignPoses,
+                                           BatchOperation::Backproject }) {
+        if (BatchOperationName(candidate) == name) {
+            operation = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void BatchStats::Print(std::ostream& out) const {
+    FlushLog();
+    const double elapsed = std::max(seconds, 1e-9);
+    out << "batch: " << scans << " scans, " << tasks << " tasks (" << failed << " failed, "
+        << skipped << " skipped), "
+        << frames << " frames in " << seconds << " s" << std::endl;
+    out << "throughput: " << scans / elapsed << " scans/s, " << frames / elapsed << " frames/s, "
+        << bytes / elapsed / (1024 * 1024) << " MB/s input" << std::endl;
+    out << "scheduler: " << steals << " stolen tasks, " << workspace_allocations
+        << " workspace column allocations, peak RSS " << PeakResidentSetSize() / (1024 * 1024)
+        << " MB" << std::endl;
+}
+
+const bool ReadScanList(const std::string& filename, std::vector<std::string>& scan_ids) {
+    std::ifstream file(filename);
+    if (!file.is_open())
+        return false;
+    std::string line{""};
+    while (std::getline(file, line)) {
+        line.erase(std::remove_if(line.begin(), line.end(), ::isspace), line.end());
+        if (!line.empty() && line[0] != '#')
+            scan_ids.push_back(line);
+    }
+    return true;
+}
+
+const std::vector<ReferenceGroup> GroupByReference(const RIO& rio, const std::vector<std::string>& scan_ids) {
+    const std::set<std::string> selected(scan_ids.begin(), scan_ids.end());
+    std::map<std::string, ReferenceGroup> groups;
+    for (const std::string& scan_id: selected) {
+        if (!rio.HasScan(scan_id)) {
+            RIO_LOG(Warning) << "skipping " << scan_id << ", it is not in 3RScan.json";
+            continue;
+        }
+        const std::string reference_id = rio.IsRescan(scan_id) ? rio.GetReference(scan_id) : scan_id;
+        ReferenceGroup& group = groups[reference_id];
+        group.reference_id = reference_id;
+        group.has_reference |= (reference_id == scan_id);
+    }
+    std::vector<ReferenceGroup> result;
+    result.reserve(groups.size());
+    for (auto& group: groups) {
+        // The reference index keeps the rescans in the order of the json file.
+        for (const std::string& rescan_id: rio.GetRescans(group.first)) {
+            if (selected.count(rescan_id) > 0)
+                group.second.rescans.push_back(rescan_id);
+        }
+        result.push_back(std::move(group.second));
+    }
+    return result;
+}
+
+const bool ParseShard(const std::string& value, int& shard, int& num_shards) {
+    const size_t slash = value.find('/');
+    if (slash == std::string::npos)
+        return false;
+    try {
+        shard = std::stoi(value.substr(0, slash));
+        num_shards = std::stoi(value.substr(slash + 1));
+    } catch (const std::exception&) {
+        return false;
+    }
+    return num_shards > 0 && shard >= 0 && shard < num_shards;
+}
+
+BatchJournal::BatchJournal(const std::string& folder, const int shard, const int num_shards):
+    folder_(folder), shard_(shard), num_shards_(num_shards) {
+}
+
+const std::string BatchJournal::ShardFile(const std::string& folder, const int shard, const int num_shards) {
+    return folder + "/shard-" + std::to_string(shard) + "-of-" + std::to_string(num_shards) + ".journal";
+}
+
+const std::string BatchJournal::MergedFile(const std::string& folder) {
+    return folder + "/merged.journal";
+}
+
+const bool BatchJournal::Open() {
+    for (const std::string& filename: { MergedFile(folder_), ShardFile(folder_, shard_, num_shards_) }) {
+        std::ifstream file(filename);
+        std::string line{""};
+        // An interrupted run may leave a partial last line, it never matches an entry.
+        while (std::getline(file, line))
+            completed_.insert(line);
+    }
+    file_.open(ShardFile(folder_, shard_, num_shards_), std::ios::app);
+    return file_.is_open();
+}
+
+const bool BatchJournal::Contains(const std::string& scan_id, const BatchOperation operation,
+                                  const uint64_t hash) const {
+    return completed_.count(scan_id + " " + BatchOperationName(operation) + " " + HashToString(hash)) > 0;
+}
+
+void BatchJournal::Record(const std::string& scan_id, const BatchOperation operation, const uint64_t hash) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_ << scan_id << " " << BatchOperationName(operation) << " " << HashToString(hash) << std::endl;
+}
+
+const bool MergeJournals(const std::string& folder, const int num_shards) {
+    std::set<std::string> entries;
+    std::vector<std::string> files{ BatchJournal::MergedFile(folder) };
+    for (int shard = 0; shard < num_shards; shard++)
+        files.push_back(BatchJournal::ShardFile(folder, shard, num_shards));
+    for (const std::string& filename: files) {
+        std::ifstream file(filename);
+        std::string line{""};
+        while (std::getline(file, line)) {
+            // Skip partial lines of interrupted runs.
+            std::istringstream entry(line);
+            std::string scan_id{""}, operation{""}, hash{""};
+            if ((entry >> scan_id >> operation >> hash) && hash.size() == 16)
+                entries.insert(line);
+        }
+    }
+    // Replace the merged journal atomically so that running shards never read a partial file.
+    return WriteAtomically(BatchJournal::MergedFile(folder), [&](const std::string& filename) {
+        std::ofstream file(filename);
+        for (const std::string& entry: entries)
+            file << entry << "\n";
+        return file.good();
+    });
+}
+
+Batch::Batch(const RIO& rio, const RIOConfig& config): rio_(rio),
+                                                       data_config_(config.data_path),
+                                                       frame_config_(config.data_path) {
+}
+
+const size_t Batch::Cost(const std::string& scan_id, const BatchOperation operation) const {
+    return Cost(scan_id, operation, IsFrameOperation(operation) ? rio_.GetNumFrames(scan_id) : 0);
+}
+
+const size_t Batch::Cost(const std::string& scan_id, const BatchOperation operation,
+                         const int frames) const {
+    switch (operation) {
+        case BatchOperation::Transform2Reference:
+            return FileSize(data_config_.GetInstance(scan_id)) + FileSize(data_config_.GetMesh(scan_id));
+        case BatchOperation::RemapLabelsPly:
+        case BatchOperation::ReSavePLYASCII:
+            return FileSize(data_config_.GetInstance(scan_id));
+        case BatchOperation::AlignPoses:
+            return frames * kPoseBytes;
+        case BatchOperation::Backproject:
+            // All frames of a scan have about the same size.
+            return frames * (FileSize(frame_config_.GetDepth(scan_id, 0)) +
+                             FileSize(frame_config_.GetColor(scan_id, 0)) + kPoseBytes);
+    }
+    return 0;
+}
+
+const std::vector<std::string> Batch::Shard(const std::vector<std::string>& scan_ids,
+                                            const BatchOptions& options) const {
+    if (options.num_shards <= 1)
+        return scan_ids;
+    size_t mesh_operations = 0, frame_operations = 0;
+    for (const BatchOperation operation: options.operations)
+        (IsFrameOperation(operation) ? frame_operations : mesh_operations)++;
+    std::vector<std::pair<size_t, std::string>> weights;
+    for (const std::string& scan_id: scan_ids) {
+        const size_t vertices = mesh_operations ? PlyVertexCount(data_config_.GetInstance(scan_id)) : 0;
+        const size_t frames = frame_operations ? rio_.GetNumFrames(scan_id) : 0;
+        weights.emplace_back(vertices * mesh_operations + frames * frame_operations * kFrameWeight, scan_id);
+    }
+    // Largest scan first, ties by scan id so that the order is the same everywhere.
+    std::sort(weights.begin(), weights.end(), [](const std::pair<size_t, std::string>& a,
+                                                 const std::pair<size_t, std::string>& b) {
+        return (a.first != b.first) ? a.first > b.first : a.second < b.second;
+    });
+    std::vector<size_t> loads(options.num_shards, 0);
+    std::vector<std::string> shard;
+    for (const auto& scan: weights) {
+        const size_t lightest = std::min_element(loads.begin(), loads.end()) - loads.begin();
+        loads[lightest] += scan.first;
+        if (static_cast<int>(lightest) == options.shard)
+            shard.push_back(scan.second);
+    }
+    return shard;
+}
+
+const uint64_t Batch::InputHash(const std::string& scan_id, const BatchOperation operation,
+                                const BatchOptions& options) const {
+    uint64_t hash = HashString(BatchOperationName(operation));
+    bool valid = true;
+    const auto hash_file = [&hash, &valid](const std::string& filename) {
+        bool readable = false;
+        hash = HashFile(filename, readable, hash);
+        valid = valid && readable;
+    };
+    // Outputs aligned to the reference also depend on the rescan transformation of 3RScan.json.
+    const auto hash_transform = [&]() {
+        const Eigen::Matrix4f transform = rio_.GetRescanTransform(scan_id);
+        hash = HashBytes(transform.data(), sizeof(float) * transform.size(), hash);
+    };
+    switch (operation) {
+        case BatchOperation::Transform2Reference:
+            hash_transform();
+            hash_file(data_config_.GetMesh(scan_id));
+            hash_file(data_config_.GetInstance(scan_id));
+            break;
+        case BatchOperation::RemapLabelsPly:
+            // Same metadata as the output key, so a change of objects.json reruns the task.
+            hash = HashString(rio_.RemapLabelsKey(scan_id).metadata(), hash);
+            hash_file(data_config_.GetInstance(scan_id));
+            break;
+        case BatchOperation::ReSavePLYASCII:
+            hash_file(data_config_.GetInstance(scan_id));
+            break;
+        case BatchOperation::AlignPoses:
+        case BatchOperation::Backproject: {
+            hash = HashString(options.pose_folder + (options.backproject2reference ? " 1" : " 0"), hash);
+            if (operation == BatchOperation::AlignPoses || options.backproject2reference)
+                hash_transform();
+            hash_file(frame_config_.GetCameraInfo(scan_id));
+            const int frames = rio_.GetNumFrames(scan_id);
+            for (int frame_id = 0; frame_id < frames; frame_id++) {
+                hash_file(frame_config_.GetPose(scan_id, frame_id));
+                // The images are only identified by their size, hashing them costs as much as the work.
+                if (operation == BatchOperation::Backproject) {
+                    const uint64_t sizes[2] = { FileSize(frame_config_.GetDepth(scan_id, frame_id)),
+                                                FileSize(frame_config_.GetColor(scan_id, frame_id)) };
+                    hash = HashBytes(sizes, sizeof(sizes), hash);
+                }
+            }
+            break;
+        }
+    }
+    return valid ? hash : kInvalidInputHash;
+}
+
+const BatchStats Batch::Run(const std::vector<std::string>& all_scan_ids, const BatchOptions& options) const {
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<std::string> scan_ids = Shard(all_scan_ids, options);
+    BatchStats stats;
+    stats.scans = scan_ids.size();
+    std::vector<BatchJob> jobs;
+    for (const std::string& scan_id: scan_ids) {
+        const bool frame_operations = std::any_of(options.operations.begin(), options.operations.end(),
+                                                  IsFrameOperation);
+        const int frames = frame_operations ? rio_.GetNumFrames(scan_id) : 0;
+        for (const BatchOperation operation: options.operations) {
+            // Only rescans are aligned to their reference.
+            if (operation == BatchOperation::Transform2Reference && !rio_.IsRescan(scan_id))
+                continue;
+            jobs.push_back({ scan_id, operation, frames, Cost(scan_id, operation, frames) });
+            stats.bytes += jobs.back().cost;
+        }
+    }
+    std::stable_sort(jobs.begin(), jobs.end(), [](const BatchJob& a, const BatchJob& b) {
+        return a.cost > b.cost;
+    });
+    std::unique_ptr<BatchJournal> journal;
+    if (!options.journal_folder.empty()) {
+        journal.reset(new BatchJournal(options.journal_folder, options.shard, options.num_shards));
+        if (!journal->Open()) {
+            RIO_LOG(Error) << "can not open journal in " << options.journal_folder
+                           << ", running without a journal";
+            journal.reset();
+        }
+    }
+
+    ThreadPool pool(options.num_threads);
+    std::vector<PlyWorkspace> workspaces(pool.num_threads());
+    std::atomic<size_t> tasks{0}, failed{0}, skipped{0}, frames{0};
+    const int frames_per_task = std::max(1, options.frames_per_task);
+    for (const BatchJob& job: jobs) {
+        const std::string name = BatchOperationName(job.operation) + " of " + job.scan_id;
+        pool.Submit(CatchFailures(name, failed, [&, job, name]() {
+            // Tasks with unreadable inputs run but are never journaled.
+            const uint64_t hash = journal ? InputHash(job.scan_id, job.operation, options) : kInvalidInputHash;
+            const bool journaled = hash != kInvalidInputHash;
+            if (journaled && journal->Contains(job.scan_id, job.operation, hash)) {
+                skipped++;
+                return;
+            }
+            if (IsFrameOperation(job.operation)) {
+                // Split the sequence into frame ranges, idle workers steal them. The
+                // last range to finish records the scan in the journal, a range that
+                // throws never does. The aligned poses of all frames are loaded once
+                // and shared by the ranges.
+                const auto poses = std::make_shared<Eigen::Matrix4Xf>();
+                if (job.operation == BatchOperation::AlignPoses &&
+                    rio_.GetCameraPoses(job.scan_id, *poses, true, false) < job.frames) {
+                    tasks++;
+                    failed++;
+                    return;
+                }
+                const std::string pose_folder = data_config_.base_path + "/" + job.scan_id + "/" + options.pose_folder;
+                const int ranges = (job.frames + frames_per_task - 1) / frames_per_task;
+                const auto remaining = std::make_shared<std::atomic<int>>(ranges);
+                const auto success = std::make_shared<std::atomic<bool>>(true);
+                for (int begin = 0; begin < job.frames; begin += frames_per_task) {
+                    pool.Submit(CatchFailures(name, failed, [&, job, begin, hash, journaled, remaining, success,
+                                                             poses, pose_folder]() {
+                        const int end = std::min(job.frames, begin + frames_per_task);
+                        bool range_success = true;
+                        if (job.operation == BatchOperation::AlignPoses) {
+                            range_success = SavePoses(pose_folder, frame_config_.frame_prefix, *poses, begin, end);
+                        } else {
+                            for (int frame_id = begin; frame_id < end; frame_id++)
+                                range_success &= rio_.Backproject(job.scan_id, frame_id, options.backproject2reference);
+                        }
+                        frames += end - begin;
+                        tasks++;
+                        if (!range_success) {
+                            failed++;
+                            *success = false;
+                        }
+                        if (--*remaining == 0 && *success && journaled)
+                            journal->Record(job.scan_id, job.operation, hash);
+                    }));
+                }
+                return;
+            }
+            PlyWorkspace& workspace = workspaces[pool.worker()];
+            bool success = false;
+            if (job.operation == BatchOperation::Transform2Reference)
+                success = rio_.Transform2Reference(job.scan_id, workspace);
+            else if (job.operation == BatchOperation::RemapLabelsPly)
+                success = rio_.RemapLabelsPly(job.scan_id, workspace);
+            else
+                success = rio_.ReSavePLYASCII(job.scan_id, workspace);
+            tasks++;
+            if (!success)
+                failed++;
+            else if (journaled)
+                journal->Record(job.scan_id, job.operation, hash);
+        }));
+    }
+    pool.Wait();
+
+    stats.tasks = tasks;
+    stats.failed = failed;
+    stats.skipped = skipped;
+    stats.frames = frames;
+    stats.steals = pool.steals();
+    for (const PlyWorkspace& workspace: workspaces)
+        stats.workspace_allocations += workspace.allocations();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+const size_t Batch::ForEachReference(const std::vector<std::string>& scan_ids,
+                                     const std::function<bool(const ReferenceGroup&)>& process,
+                                     const unsigned num_threads) const {
+    const std::vector<ReferenceGroup> groups = GroupByReference(rio_, scan_ids);
+    // The reference is loaded once, so a group costs its reference plus every rescan.
+    std::vector<std::pair<size_t, size_t>> order;
+    for (size_t i = 0; i < groups.size(); i++) {
+        size_t cost = Cost(groups[i].reference_id, BatchOperation::ReSavePLYASCII);
+        for (const std::string& rescan_id: groups[i].rescans)
+            cost += Cost(rescan_id, BatchOperation::Transform2Reference);
+        order.emplace_back(cost, i);
+    }
+    std::stable_sort(order.begin(), order.end(), [](const std::pair<size_t, size_t>& a,
+                                                    const std::pair<size_t, size_t>& b) {
+        return a.first > b.first;
+    });
+    ThreadPool pool(num_threads);
+    std::atomic<size_t> failed{0};
+    for (const auto& entry: order) {
+        const ReferenceGroup& group = groups[entry.second];
+        pool.Submit(CatchFailures("reference " + group.reference_id, failed, [&process, &group, &failed]() {
+            if (!process(group))
+                failed++;
+        }));
+    }
+    pool.Wait();
+    return failed;
+}
+
+}  // namespace RIO
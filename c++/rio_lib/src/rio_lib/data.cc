@@ -4,9 +4,10 @@
 #include <iostream>
 
 #include "rio_lib/data.h"
+#include "rio_lib/log.h"
 
 Data::Data(const std::string& data_file) {
-    std::cout << "loading " << data_file << std::endl;
+    RIO_LOG(Info) << "loading " << data_file;
     ReadJson(data_file);
 }
 
@@ -17,16 +18,19 @@ void Data::ReadJson(const std::string& data_file) {
     std::string err;
     const auto json = json11::Json::parse(dataset, err);
     if (err != "") {
-        std::cerr << "Error reading " << data_file << " " << err << std::endl;
+        RIO_LOG(Error) << "reading " << data_file << " " << err;
         return;
     }
     for (auto &s: json.array_items()) {
         const auto scans = s["scans"].array_items();
         const std::string& reference_id = s["reference"].string_value();
         const std::string& type = s["type"].string_value();
+        // Also lists references without rescans.
+        reference2rescans[reference_id];
         for (auto &scan: scans) {
             const std::string& scan_id = scan["reference"].string_value();
             scan2references[scan_id] = reference_id;
+            reference2rescans[reference_id].push_back(scan_id);
             if (type != "test")
                 ReadRescanJson(scan_id, reference_id, scan);
         }
@@ -73,6 +77,10 @@ const bool Data::IsReference(const std::string& scan_id) const {
     return !IsRescan(scan_id);
 }
 
+const bool Data::HasScan(const std::string& scan_id) const {
+    return IsRescan(scan_id) || reference2rescans.find(scan_id) != reference2rescans.end();
+}
+
 const Eigen::Matrix4f Data::GetRescanTransform(const std::string& scan_id) const {
     if (rescans.find(scan_id) != rescans.end())
         return rescans.at(scan_id).rescan2reference;
@@ -92,3 +100,13 @@ const Eigen::Matrix4f Data::GetRigidTransform(const std::string& scan_id, const
 const std::map<std::string, std::string>& Data::GetScan2References() const {
     return scan2references;
 }
+
+const std::vector<std::string>& Data::GetRescans(const std::string& reference_id) const {
+    static const std::vector<std::string> none;
+    const auto rescans = reference2rescans.find(reference_id);
+    return (rescans != reference2rescans.end()) ? rescans->second : none;
+}
+
+const std::map<std::string, std::vector<std::string>>& Data::GetReference2Rescans() const {
+    return reference2rescans;
+}
@@ -0,0 +1,138 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#include "rio_lib/geometry_cache.h"
+
+namespace RIO {
+
+namespace {
+
+// Files that missed once are remembered up to this number, then forgotten all at once.
+constexpr size_t kMaxRequested = 4096;
+
+const bool SameState(const FileState& a, const FileState& b) {
+    return a.size == b.size && a.mtime == b.mtime;
+}
+
+}  // namespace
+
+GeometryCache::GeometryCache(const size_t budget_bytes): budget_bytes_(budget_bytes) {
+}
+
+std::shared_ptr<const RIOPlyData> GeometryCache::Find(const std::string& filename, bool& repeated) {
+    repeated = false;
+    FileState state;
+    const bool exists = GetFileState(filename, state);
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto entry = lookup_.find(filename);
+    if (entry != lookup_.end()) {
+        if (exists && SameState(entry->second->state, state)) {
+            entries_.splice(entries_.begin(), entries_, entry->second);
+            hits_++;
+            return entry->second->ply;
+        }
+        // The file changed since it was loaded.
+        Erase(entry);
+    }
+    misses_++;
+    if (!exists)
+        return nullptr;
+    const auto request = requested_.find(filename);
+    if (request != requested_.end() && SameState(request->second, state)) {
+        repeated = true;
+        return nullptr;
+    }
+    if (requested_.size() >= kMaxRequested)
+        requested_.clear();
+    requested_[filename] = state;
+    return nullptr;
+}
+
+std::shared_ptr<const RIOPlyData> GeometryCache::Load(const std::string& filename) {
+    // The state before parsing, so a file that changes meanwhile is loaded again next time.
+    FileState state;
+    if (!GetFileState(filename, state))
+        return nullptr;
+    // Parse without holding the lock, other scans stay available meanwhile.
+    std::shared_ptr<RIOPlyData> ply = std::make_shared<RIOPlyData>();
+    if (ply->load(filename) == 0)
+        return nullptr;
+    const size_t size = ply->capacity_bytes();
+    if (size > budget_bytes_)
+        return ply;
+    std::lock_guard<std::mutex> lock(mutex_);
+    requested_.erase(filename);
+    // Another thread may have loaded the same file in the meantime.
+    const auto entry = lookup_.find(filename);
+    if (entry != lookup_.end()) {
+        if (SameState(entry->second->state, state))
+            return entry->second->ply;
+        Erase(entry);
+    }
+    entries_.push_front(Entry{filename, state, ply});
+    lookup_[filename] = entries_.begin();
+    bytes_ += size;
+    Shrink();
+    return ply;
+}
+
+std::shared_ptr<const RIOPlyData> GeometryCache::Get(const std::string& filename) {
+    bool repeated = false;
+    const std::shared_ptr<const RIOPlyData> cached = Find(filename, repeated);
+    return cached ? cached : Load(filename);
+}
+
+const bool GeometryCache::Contains(const std::string& filename) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lookup_.find(filename) != lookup_.end();
+}
+
+void GeometryCache::Evict(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    requested_.erase(filename);
+    const auto entry = lookup_.find(filename);
+    if (entry != lookup_.end())
+        Erase(entry);
+}
+
+void GeometryCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lookup_.clear();
+    requested_.clear();
+    bytes_ = 0;
+}
+
+void GeometryCache::Shrink() {
+    while (bytes_ > budget_bytes_ && !entries_.empty())
+        Erase(lookup_.find(entries_.back().filename));
+}
+
+void GeometryCache::Erase(std::unordered_map<std::string, std::list<Entry>::iterator>::iterator entry) {
+    bytes_ -= entry->second->ply->capacity_bytes();
+    entries_.erase(entry->second);
+    lookup_.erase(entry);
+}
+
+const size_t GeometryCache::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+const size_t GeometryCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+const size_t GeometryCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+}  // namespace RIO
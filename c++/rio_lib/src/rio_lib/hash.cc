@@ -0,0 +1,53 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#include "rio_lib/hash.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace RIO {
+
+const uint64_t HashBytes(const void* data, const size_t size, uint64_t hash) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+const uint64_t HashString(const std::string& value, uint64_t hash) {
+    // The size separates consecutive strings.
+    const uint64_t size = value.size();
+    hash = HashBytes(&size, sizeof(size), hash);
+    return HashBytes(value.data(), value.size(), hash);
+}
+
+const uint64_t HashFile(const std::string& filename, bool& valid, uint64_t hash) {
+    valid = false;
+    FILE* file = std::fopen(filename.c_str(), "rb");
+    if (file == nullptr)
+        return hash;
+    std::vector<char> buffer(1 << 20);
+    size_t read = 0;
+    while ((read = std::fread(buffer.data(), 1, buffer.size(), file)) > 0)
+        hash = HashBytes(buffer.data(), read, hash);
+    valid = !std::ferror(file);
+    std::fclose(file);
+    return hash;
+}
+
+const std::string HashToString(const uint64_t hash) {
+    char buffer[17];
+    std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(hash));
+    return buffer;
+}
+
+}  // namespace RIO
@@ -0,0 +1,143 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#include "rio_lib/instance_index.h"
+
+#include <algorithm>
+
+namespace RIO {
+
+void InstanceIndex::Build(const RIOPlyData& ply) {
+    Build(ply.object_ids, ply.faces);
+}
+
+void InstanceIndex::Build(const std::vector<uint16_t>& object_ids, const std::vector<uint32_t>& faces) {
+    scene_faces_ = faces.size() / 3;
+    const uint16_t max_id = object_ids.empty() ? 0 : *std::max_element(object_ids.begin(), object_ids.end());
+    // Counting pass: each face is counted once for every distinct instance of its vertices.
+    offsets_.assign(max_id + 2, 0);
+    for (size_t i = 0; i < scene_faces_; i++) {
+        const uint16_t a = object_ids[faces[3*i]];
+        const uint16_t b = object_ids[faces[3*i+1]];
+        const uint16_t c = object_ids[faces[3*i+2]];
+        offsets_[a + 1]++;
+        if (b != a)
+            offsets_[b + 1]++;
+        if (c != a && c != b)
+            offsets_[c + 1]++;
+    }
+    for (size_t i = 1; i < offsets_.size(); i++)
+        offsets_[i] += offsets_[i - 1];
+    // Placement pass, faces keep their order within an instance.
+    faces_.resize(offsets_.back());
+    std::vector<uint32_t> cursor(offsets_.begin(), offsets_.end() - 1);
+    for (size_t i = 0; i < scene_faces_; i++) {
+        const uint16_t a = object_ids[faces[3*i]];
+        const uint16_t b = object_ids[faces[3*i+1]];
+        const uint16_t c = object_ids[faces[3*i+2]];
+        faces_[cursor[a]++] = static_cast<uint32_t>(i);
+        if (b != a)
+            faces_[cursor[b]++] = static_cast<uint32_t>(i);
+        if (c != a && c != b)
+            faces_[cursor[c]++] = static_cast<uint32_t>(i);
+    }
+}
+
+const uint32_t* InstanceIndex::begin(const int instance) const {
+    if (instance < 0 || instance + 1 >= static_cast<int>(offsets_.size()))
+        return nullptr;
+    return faces_.data() + offsets_[instance];
+}
+
+const uint32_t* InstanceIndex::end(const int instance) const {
+    if (instance < 0 || instance + 1 >= static_cast<int>(offsets_.size()))
+        return nullptr;
+    return faces_.data() + offsets_[instance + 1];
+}
+
+const size_t InstanceIndex::num_faces(const int instance) const {
+    return end(instance) - begin(instance);
+}
+
+const std::vector<int> InstanceIndex::instances() const {
+    std::vector<int> instances;
+    for (size_t i = 0; i + 1 < offsets_.size(); i++) {
+        if (offsets_[i + 1] > offsets_[i])
+            instances.push_back(static_cast<int>(i));
+    }
+    return instances;
+}
+
+const size_t InstanceIndex::scene_faces() const {
+    return scene_faces_;
+}
+
+void InstanceExtractor::Remap::Reserve(const size_t size) {
+    if (generation.size() < size) {
+        generation.resize(size, 0);
+        target.resize(size, 0);
+    }
+}
+
+const uint32_t InstanceExtractor::Remap::Map(const uint32_t i, const uint32_t current,
+                                             uint32_t& count, bool& added) {
+    added = (generation[i] != current);
+    if (added) {
+        generation[i] = current;
+        target[i] = count++;
+    }
+    return target[i];
+}
+
+void InstanceExtractor::Extract(const ObjMesh& scene, const InstanceIndex& index,
+                                const int instance, ObjMesh& mesh) {
+    mesh.clear();
+    mesh.material_library = scene.material_library;
+    mesh.material = scene.material;
+    if (++generation_ == 0) {
+        // The counter wrapped, forget all stamps.
+        for (Remap* remap: { &positions_, &uvs_, &normals_ })
+            std::fill(remap->generation.begin(), remap->generation.end(), 0);
+        generation_ = 1;
+    }
+    positions_.Reserve(scene.num_positions());
+    uvs_.Reserve(scene.num_uvs());
+    normals_.Reserve(scene.normals.size() / 3);
+
+    const bool has_uvs = !scene.uv_indices.empty();
+    const bool has_normals = !scene.normal_indices.empty();
+    uint32_t positions = 0, uvs = 0, normals = 0;
+    bool added = false;
+    const size_t faces = index.num_faces(instance);
+    mesh.position_indices.reserve(3 * faces);
+    mesh.uv_indices.reserve(has_uvs ? 3 * faces : 0);
+    mesh.normal_indices.reserve(has_normals ? 3 * faces : 0);
+    for (const uint32_t* face = index.begin(instance); face != index.end(instance); face++) {
+        for (size_t corner = 3 * *face; corner < 3 * *face + 3; corner++) {
+            const uint32_t p = scene.position_indices[corner];
+            mesh.position_indices.push_back(positions_.Map(p, generation_, positions, added));
+            if (added)
+                mesh.positions.insert(mesh.positions.end(), &scene.positions[3*p], &scene.positions[3*p] + 3);
+            if (has_uvs) {
+                const uint32_t t = scene.uv_indices[corner];
+                mesh.uv_indices.push_back(uvs_.Map(t, generation_, uvs, added));
+                if (added)
+                    mesh.uvs.insert(mesh.uvs.end(), &scene.uvs[2*t], &scene.uvs[2*t] + 2);
+            }
+            if (has_normals) {
+                const uint32_t n = scene.normal_indices[corner];
+                mesh.normal_indices.push_back(normals_.Map(n, generation_, normals, added));
+                if (added)
+                    mesh.normals.insert(mesh.normals.end(), &scene.normals[3*n], &scene.normals[3*n] + 3);
+            }
+        }
+    }
+}
+
+}  // namespace RIO
@@ -0,0 +1,107 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#include "rio_lib/label_mapping.h"
+
+#include <cstdlib>
+#include <fstream>
+
+namespace RIO {
+
+namespace {
+
+// Splits a csv or tsv line, quotes around a field are removed.
+std::vector<std::string> SplitFields(const std::string& line, const char separator) {
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (const char c: line) {
+        if (c == '"')
+            quoted = !quoted;
+        else if (c == separator && !quoted)
+            fields.emplace_back();
+        else if (c != '\r')
+            fields.back() += c;
+    }
+    return fields;
+}
+
+const int FindColumn(const std::vector<std::string>& header, const std::string& name) {
+    for (size_t i = 0; i < header.size(); i++) {
+        if (header[i].find(name) != std::string::npos && header[i].find("ID") != std::string::npos)
+            return static_cast<int>(i);
+    }
+    for (size_t i = 0; i < header.size(); i++) {
+        if (header[i] == name)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// Parses a non-negative integer field, returns -1 for empty or invalid fields.
+const int ParseId(const std::vector<std::string>& fields, const int column) {
+    if (column < 0 || column >= static_cast<int>(fields.size()) || fields[column].empty())
+        return -1;
+    char* end = nullptr;
+    const long value = std::strtol(fields[column].c_str(), &end, 10);
+    return (*end == '\0' && value >= 0) ? static_cast<int>(value) : -1;
+}
+
+}  // namespace
+
+const std::string LabelSetName(const LabelSet set) {
+    switch (set) {
+        case LabelSet::NYU40: return "NYU40";
+        case LabelSet::Eigen13: return "Eigen13";
+        case LabelSet::RIO27: return "RIO27";
+    }
+    return "";
+}
+
+const bool LabelMapping::Load(const std::string& filename) {
+    nyu40_.clear();
+    eigen13_.clear();
+    rio27_.clear();
+    std::ifstream file(filename);
+    std::string line;
+    if (!file.is_open() || !std::getline(file, line))
+        return false;
+    const char separator = (line.find('\t') != std::string::npos) ? '\t' : ',';
+    const std::vector<std::string> header = SplitFields(line, separator);
+    const int global_column = FindColumn(header, "Global");
+    const int columns[3] = { FindColumn(header, LabelSetName(LabelSet::NYU40)),
+                             FindColumn(header, LabelSetName(LabelSet::Eigen13)),
+                             FindColumn(header, LabelSetName(LabelSet::RIO27)) };
+    if (global_column < 0 || columns[0] < 0 || columns[1] < 0 || columns[2] < 0)
+        return false;
+    std::vector<uint8_t>* tables[3] = { &nyu40_, &eigen13_, &rio27_ };
+    while (std::getline(file, line)) {
+        const std::vector<std::string> fields = SplitFields(line, separator);
+        const int global_id = ParseId(fields, global_column);
+        if (global_id < 0)
+            continue;
+        for (int i = 0; i < 3; i++) {
+            const int label = ParseId(fields, columns[i]);
+            if (tables[i]->size() <= static_cast<size_t>(global_id))
+                tables[i]->resize(global_id + 1, 0);
+            if (label >= 0 && label <= 255)
+                (*tables[i])[global_id] = static_cast<uint8_t>(label);
+        }
+    }
+    return !nyu40_.empty();
+}
+
+const std::vector<uint8_t>& LabelMapping::Table(const LabelSet set) const {
+    switch (set) {
+        case LabelSet::Eigen13: return eigen13_;
+        case LabelSet::RIO27: return rio27_;
+        default: return nyu40_;
+    }
+}
+
+}  // namespace RIO
@@ -0,0 +1,139 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#include "rio_lib/log.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace RIO {
+
+namespace {
+
+const LogLevel InitialLogLevel() {
+    const char* level = std::getenv("RIO_LOG_LEVEL");
+    if (level == nullptr || level[0] < '0' || level[0] > '4')
+        return LogLevel::Info;
+    return static_cast<LogLevel>(level[0] - '0');
+}
+
+std::atomic<int> log_level{static_cast<int>(InitialLogLevel())};
+
+const char* LevelPrefix(const LogLevel level) {
+    switch (level) {
+        case LogLevel::Warning: return "Warning: ";
+        case LogLevel::Error: return "Error: ";
+        default: return "";
+    }
+}
+
+// Ring buffer of messages with one consumer thread that writes them.
+class LogSink {
+public:
+    LogSink(): slots_(kCapacity) {
+        thread_ = std::thread(&LogSink::Run, this);
+    }
+    ~LogSink() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        not_empty_.notify_one();
+        thread_.join();
+    }
+    void Push(const LogLevel level, std::string message) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this]() { return size_ < kCapacity; });
+        slots_[(head_ + size_) % kCapacity] = std::make_pair(level, std::move(message));
+        size_++;
+        pushed_++;
+        lock.unlock();
+        not_empty_.notify_one();
+    }
+    void Flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const size_t target = pushed_;
+        written_cv_.wait(lock, [this, target]() { return written_ >= target; });
+        lock.unlock();
+        // Newer messages may keep the log thread from flushing.
+        std::cout.flush();
+        std::cerr.flush();
+    }
+private:
+    static constexpr size_t kCapacity = 4096;
+    std::vector<std::pair<LogLevel, std::string>> slots_;
+    size_t head_{0};
+    size_t size_{0};
+    // Number of messages pushed and written so far.
+    size_t pushed_{0};
+    size_t written_{0};
+    bool stop_{false};
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::condition_variable written_cv_;
+    std::thread thread_;
+
+    void Run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            not_empty_.wait(lock, [this]() { return stop_ || size_ > 0; });
+            if (size_ == 0)
+                return;
+            std::pair<LogLevel, std::string> message = std::move(slots_[head_]);
+            head_ = (head_ + 1) % kCapacity;
+            size_--;
+            lock.unlock();
+            not_full_.notify_one();
+            std::ostream& out = (message.first >= LogLevel::Warning) ? std::cerr : std::cout;
+            out << LevelPrefix(message.first) << message.second << '\n';
+            lock.lock();
+            // Only flush once there is nothing left to write.
+            if (size_ == 0) {
+                lock.unlock();
+                std::cout.flush();
+                std::cerr.flush();
+                lock.lock();
+            }
+            written_++;
+            written_cv_.notify_all();
+        }
+    }
+};
+
+LogSink& Sink() {
+    static LogSink sink;
+    return sink;
+}
+
+}  // namespace
+
+void SetLogLevel(const LogLevel level) {
+    log_level = static_cast<int>(level);
+}
+
+const LogLevel GetLogLevel() {
+    return static_cast<LogLevel>(log_level.load(std::memory_order_relaxed));
+}
+
+void Log(const LogLevel level, std::string message) {
+    Sink().Push(level, std::move(message));
+}
+
+void FlushLog() {
+    Sink().Flush();
+}
+
+}  // namespace RIO
@@ -0,0 +1,526 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#include "rio_lib/obj_loader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "rio_lib/thread_pool.h"
+
+namespace RIO {
+
+namespace {
+
+// Powers of ten that are exactly representable as float.
+const float kPow10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+// Largest integer that is exactly representable as float.
+constexpr uint64_t kMaxExactMantissa = uint64_t(1) << 24;
+
+inline const bool IsSpace(const char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const bool IsDigit(const char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline const char* SkipSpaces(const char* p, const char* end) {
+    while (p < end && IsSpace(*p))
+        p++;
+    return p;
+}
+
+inline const char* LineEnd(const char* p, const char* end) {
+    const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return (eol == nullptr) ? end : eol;
+}
+
+// Parses a float and advances p. Short decimals (all of the vertices in 3RScan)
+// are converted exactly with one float multiplication or division, the rest
+// is handed to strtof so that the result always matches std::istream.
+const bool ParseFloat(const char*& p, const char* end, float& value) {
+    p = SkipSpaces(p, end);
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = (*p++ == '-');
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    bool exact = true;
+    for (; p < end && IsDigit(*p); p++, digits++) {
+        if (mantissa < kMaxExactMantissa)
+            mantissa = mantissa * 10 + (*p - '0');
+        else exact = false;
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && IsDigit(*p); p++, digits++) {
+            if (mantissa < kMaxExactMantissa) {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            } else exact = false;
+        }
+    }
+    if (digits == 0) {
+        p = start;
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negative_exponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            negative_exponent = (*q++ == '-');
+        if (q < end && IsDigit(*q)) {
+            int e = 0;
+            for (; q < end && IsDigit(*q); q++)
+                e = std::min(e * 10 + (*q - '0'), 10000);
+            exponent += negative_exponent ? -e : e;
+            p = q;
+        }
+    }
+    if (exact && mantissa <= kMaxExactMantissa && exponent >= -10 && exponent <= 10) {
+        const float m = static_cast<float>(mantissa);
+        value = (exponent < 0) ? m / kPow10[-exponent] : m * kPow10[exponent];
+        if (negative)
+            value = -value;
+        return true;
+    }
+    char buffer[64];
+    const size_t length = std::min(static_cast<size_t>(p - start), sizeof(buffer) - 1);
+    std::memcpy(buffer, start, length);
+    buffer[length] = '\0';
+    value = std::strtof(buffer, nullptr);
+    return true;
+}
+
+// Parses a (possibly negative) integer and advances p.
+const bool ParseInt(const char*& p, const char* end, int64_t& value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = (*p++ == '-');
+    if (p >= end || !IsDigit(*p))
+        return false;
+    value = 0;
+    for (; p < end && IsDigit(*p); p++)
+        value = value * 10 + (*p - '0');
+    if (negative)
+        value = -value;
+    return true;
+}
+
+// Returns the statement keyword of a line (e.g. "v", "vt" or "f").
+inline const std::string Keyword(const char* p, const char* eol) {
+    const char* q = p;
+    while (q < eol && !IsSpace(*q))
+        q++;
+    return std::string(p, q);
+}
+
+inline const std::string Rest(const char* p, const char* eol) {
+    p = SkipSpaces(p, eol);
+    while (eol > p && IsSpace(*(eol - 1)))
+        eol--;
+    return std::string(p, eol);
+}
+
+// Index of an obj statement that still has to be resolved once the number of
+// elements in the preceding chunks is known.
+struct RelativeIndex {
+    size_t slot;
+    int64_t value;
+};
+
+struct ObjChunk {
+    ObjMesh mesh;
+    // Negative (relative) indices, resolved after all chunks are parsed.
+    std::vector<RelativeIndex> relative_positions;
+    std::vector<RelativeIndex> relative_uvs;
+    std::vector<RelativeIndex> relative_normals;
+    bool all_uvs{true};
+    bool all_normals{true};
+    bool valid{true};
+};
+
+// Face corner as written in the file (1-based or negative, 0 = not set).
+struct Corner {
+    int64_t position{0};
+    int64_t uv{0};
+    int64_t normal{0};
+};
+
+const bool ParseCorner(const char*& p, const char* end, Corner& corner) {
+    corner = Corner();
+    if (!ParseInt(p, end, corner.position))
+        return false;
+    if (p < end && *p == '/') {
+        p++;
+        if (p < end && *p != '/')
+            ParseInt(p, end, corner.uv);
+        if (p < end && *p == '/') {
+            p++;
+            ParseInt(p, end, corner.normal);
+        }
+    }
+    return true;
+}
+
+// Adds one index to indices. Positive obj indices are absolute, negative ones
+// are relative to the elements parsed so far.
+void AddIndex(const int64_t value, const size_t parsed, std::vector<uint32_t>& indices,
+              std::vector<RelativeIndex>& relative) {
+    if (value > 0) {
+        indices.push_back(static_cast<uint32_t>(value - 1));
+    } else {
+        relative.push_back({ indices.size(), static_cast<int64_t>(parsed) + value });
+        indices.push_back(0);
+    }
+}
+
+void ParseFace(const char* p, const char* eol, ObjChunk& chunk) {
+    ObjMesh& mesh = chunk.mesh;
+    std::vector<Corner> corners;
+    Corner corner;
+    p = SkipSpaces(p, eol);
+    while (p < eol && ParseCorner(p, eol, corner)) {
+        corners.push_back(corner);
+        p = SkipSpaces(p, eol);
+    }
+    if (corners.size() < 3) {
+        if (!corners.empty())
+            chunk.valid = false;
+        return;
+    }
+    for (size_t i = 1; i + 1 < corners.size(); i++) {
+        for (const Corner& c: { corners[0], corners[i], corners[i + 1] }) {
+            AddIndex(c.position, mesh.num_positions(), mesh.position_indices, chunk.relative_positions);
+            if (c.uv == 0)
+                chunk.all_uvs = false;
+            else
+                AddIndex(c.uv, mesh.num_uvs(), mesh.uv_indices, chunk.relative_uvs);
+            if (c.normal == 0)
+                chunk.all_normals = false;
+            else
+                AddIndex(c.normal, mesh.normals.size() / 3, mesh.normal_indices, chunk.relative_normals);
+        }
+    }
+}
+
+void ParseChunk(const char* begin, const char* end, ObjChunk& chunk) {
+    ObjMesh& mesh = chunk.mesh;
+    float value;
+    for (const char* line = begin; line < end;) {
+        const char* eol = LineEnd(line, end);
+        const char* p = SkipSpaces(line, eol);
+        if (p + 1 < eol && p[0] == 'v' && IsSpace(p[1])) {
+            p++;
+            for (int i = 0; i < 3; i++) {
+                if (!ParseFloat(p, eol, value))
+                    chunk.valid = false;
+                mesh.positions.push_back(value);
+            }
+        } else if (p + 2 < eol && p[0] == 'v' && p[1] == 't' && IsSpace(p[2])) {
+            p += 2;
+            for (int i = 0; i < 2; i++) {
+                if (!ParseFloat(p, eol, value))
+                    chunk.valid = false;
+                mesh.uvs.push_back(value);
+            }
+        } else if (p + 2 < eol && p[0] == 'v' && p[1] == 'n' && IsSpace(p[2])) {
+            p += 2;
+            for (int i = 0; i < 3; i++) {
+                if (!ParseFloat(p, eol, value))
+                    chunk.valid = false;
+                mesh.normals.push_back(value);
+            }
+        } else if (p + 1 < eol && p[0] == 'f' && IsSpace(p[1])) {
+            ParseFace(p + 1, eol, chunk);
+        } else if (p < eol && (*p == 'm' || *p == 'u')) {
+            const std::string keyword = Keyword(p, eol);
+            if (keyword == "mtllib" && mesh.material_library.empty())
+                mesh.material_library = Rest(p + keyword.size(), eol);
+            else if (keyword == "usemtl" && mesh.material.empty())
+                mesh.material = Rest(p + keyword.size(), eol);
+        }
+        line = eol + 1;
+    }
+}
+
+template<class T>
+void Append(std::vector<T>& target, const std::vector<T>& source) {
+    target.insert(target.end(), source.begin(), source.end());
+}
+
+void Resolve(const std::vector<RelativeIndex>& relative, const size_t offset, const size_t slot_offset,
+             std::vector<uint32_t>& indices) {
+    for (const RelativeIndex& index: relative)
+        indices[slot_offset + index.slot] = static_cast<uint32_t>(static_cast<int64_t>(offset) + index.value);
+}
+
+const bool InRange(const std::vector<uint32_t>& indices, const size_t size) {
+    for (const uint32_t index: indices) {
+        if (index >= size)
+            return false;
+    }
+    return true;
+}
+
+// Runs function(i) for i in [0, parts) with one thread per part.
+template<class Function>
+void RunParallel(const size_t parts, Function function) {
+    if (parts <= 1) {
+        if (parts == 1)
+            function(0);
+        return;
+    }
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < parts; i++)
+        threads.emplace_back(function, i);
+    function(0);
+    for (std::thread& thread: threads)
+        thread.join();
+}
+
+// Smallest chunk that is worth a thread of its own.
+constexpr size_t kMinChunkSize = 1 << 20;
+
+const unsigned ChunkCount(const size_t size, unsigned num_threads) {
+    if (num_threads == 0)
+        num_threads = DefaultThreads();
+    return static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(num_threads, size / kMinChunkSize)));
+}
+
+inline void AppendFormat(std::string& out, const char* format, const float a, const float b) {
+    char buffer[64];
+    const int length = std::snprintf(buffer, sizeof(buffer), format, a, b);
+    out.append(buffer, length);
+}
+
+inline void AppendFormat(std::string& out, const char* format, const float a, const float b, const float c) {
+    char buffer[96];
+    const int length = std::snprintf(buffer, sizeof(buffer), format, a, b, c);
+    out.append(buffer, length);
+}
+
+const bool WriteFile(const std::string& filename, const std::vector<std::string>& parts) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    for (const std::string& part: parts)
+        file.write(part.data(), part.size());
+    return file.good();
+}
+
+}  // namespace
+
+void ObjMesh::clear() {
+    positions.clear();
+    uvs.clear();
+    normals.clear();
+    position_indices.clear();
+    uv_indices.clear();
+    normal_indices.clear();
+    material_library.clear();
+    material.clear();
+}
+
+MappedFile::MappedFile(const std::string& filename) {
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat info;
+    if (::fstat(fd, &info) == 0) {
+        size_ = static_cast<size_t>(info.st_size);
+        open_ = true;
+        if (size_ > 0) {
+            void* address = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                ::madvise(address, size_, MADV_SEQUENTIAL);
+                data_ = static_cast<const char*>(address);
+                mapped_ = true;
+            } else {
+                // Fall back to reading the file (e.g. for pipes or special file systems).
+                buffer_.resize(size_);
+                const ssize_t read = ::pread(fd, buffer_.data(), size_, 0);
+                open_ = (read == static_cast<ssize_t>(size_));
+                data_ = buffer_.data();
+            }
+        }
+    }
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (mapped_)
+        ::munmap(const_cast<char*>(data_), size_);
+}
+
+std::vector<size_t> SplitLines(const char* data, const size_t size, const unsigned parts) {
+    std::vector<size_t> offsets{0};
+    for (unsigned i = 1; i < parts; i++) {
+        size_t offset = std::max(offsets.back(), size * i / parts);
+        const char* eol = (offset < size) ? LineEnd(data + offset, data + size) : data + size;
+        offset = std::min(size, static_cast<size_t>(eol - data) + 1);
+        if (offset > offsets.back() && offset < size)
+            offsets.push_back(offset);
+    }
+    offsets.push_back(size);
+    return offsets;
+}
+
+const bool LoadObj(const std::string& filename, ObjMesh& mesh, unsigned num_threads) {
+    mesh.clear();
+    const MappedFile file(filename);
+    if (!file.is_open())
+        return false;
+    const std::vector<size_t> offsets = SplitLines(file.data(), file.size(),
+                                                   ChunkCount(file.size(), num_threads));
+    std::vector<ObjChunk> chunks(offsets.size() - 1);
+    RunParallel(chunks.size(), [&](const size_t i) {
+        ParseChunk(file.data() + offsets[i], file.data() + offsets[i + 1], chunks[i]);
+    });
+    // Concatenate the chunks in file order.
+    size_t positions = 0, uvs = 0, normals = 0, corners = 0;
+    bool all_uvs = true, all_normals = true, valid = true;
+    for (const ObjChunk& chunk: chunks) {
+        positions += chunk.mesh.positions.size();
+        uvs += chunk.mesh.uvs.size();
+        normals += chunk.mesh.normals.size();
+        corners += chunk.mesh.position_indices.size();
+        all_uvs &= chunk.all_uvs;
+        all_normals &= chunk.all_normals;
+        valid &= chunk.valid;
+    }
+    mesh.positions.reserve(positions);
+    mesh.uvs.reserve(uvs);
+    mesh.normals.reserve(normals);
+    mesh.position_indices.reserve(corners);
+    mesh.uv_indices.reserve(all_uvs ? corners : 0);
+    mesh.normal_indices.reserve(all_normals ? corners : 0);
+    for (const ObjChunk& chunk: chunks) {
+        const size_t slot = mesh.position_indices.size();
+        Append(mesh.position_indices, chunk.mesh.position_indices);
+        Resolve(chunk.relative_positions, mesh.num_positions(), slot, mesh.position_indices);
+        if (all_uvs) {
+            const size_t uv_slot = mesh.uv_indices.size();
+            Append(mesh.uv_indices, chunk.mesh.uv_indices);
+            Resolve(chunk.relative_uvs, mesh.num_uvs(), uv_slot, mesh.uv_indices);
+        }
+        if (all_normals) {
+            const size_t normal_slot = mesh.normal_indices.size();
+            Append(mesh.normal_indices, chunk.mesh.normal_indices);
+            Resolve(chunk.relative_normals, mesh.normals.size() / 3, normal_slot, mesh.normal_indices);
+        }
+        Append(mesh.positions, chunk.mesh.positions);
+        Append(mesh.uvs, chunk.mesh.uvs);
+        Append(mesh.normals, chunk.mesh.normals);
+        if (mesh.material_library.empty())
+            mesh.material_library = chunk.mesh.material_library;
+        if (mesh.material.empty())
+            mesh.material = chunk.mesh.material;
+    }
+    if (!all_uvs)
+        mesh.uv_indices.clear();
+    if (!all_normals)
+        mesh.normal_indices.clear();
+    return valid && InRange(mesh.position_indices, mesh.num_positions()) &&
+           InRange(mesh.uv_indices, mesh.num_uvs()) &&
+           InRange(mesh.normal_indices, mesh.normals.size() / 3);
+}
+
+const bool SaveObj(const std::string& filename, const ObjMesh& mesh) {
+    std::string out;
+    FormatObj(mesh, out);
+    return WriteFile(filename, { out });
+}
+
+void FormatObj(const ObjMesh& mesh, std::string& out) {
+    out.reserve(out.size() + mesh.positions.size() * 10 + mesh.uvs.size() * 10 + mesh.position_indices.size() * 12);
+    if (!mesh.material_library.empty())
+        out += "mtllib " + mesh.material_library + "\n";
+    for (size_t i = 0; i < mesh.positions.size(); i += 3)
+        AppendFormat(out, "v %g %g %g\n", mesh.positions[i], mesh.positions[i + 1], mesh.positions[i + 2]);
+    for (size_t i = 0; i < mesh.uvs.size(); i += 2)
+        AppendFormat(out, "vt %g %g\n", mesh.uvs[i], mesh.uvs[i + 1]);
+    for (size_t i = 0; i < mesh.normals.size(); i += 3)
+        AppendFormat(out, "vn %g %g %g\n", mesh.normals[i], mesh.normals[i + 1], mesh.normals[i + 2]);
+    if (!mesh.material.empty())
+        out += "usemtl " + mesh.material + "\n";
+    const bool uvs = !mesh.uv_indices.empty();
+    const bool normals = !mesh.normal_indices.empty();
+    for (size_t i = 0; i < mesh.position_indices.size(); i++) {
+        out += (i % 3 == 0) ? "f " : " ";
+        out += std::to_string(mesh.position_indices[i] + 1);
+        if (uvs || normals)
+            out += '/';
+        if (uvs)
+            out += std::to_string(mesh.uv_indices[i] + 1);
+        if (normals)
+            out += '/' + std::to_string(mesh.normal_indices[i] + 1);
+        if (i % 3 == 2)
+            out += "\n";
+    }
+}
+
+const bool TransformObj(const std::string& input, const std::string& output,
+                        const float* matrix, unsigned num_threads) {
+    const float* m = matrix;
+    const MappedFile file(input);
+    if (!file.is_open())
+        return false;
+    const char* data = file.data();
+    const std::vector<size_t> offsets = SplitLines(data, file.size(), ChunkCount(file.size(), num_threads));
+    std::vector<std::string> parts(offsets.size() - 1);
+    RunParallel(parts.size(), [&](const size_t i) {
+        const char* end = data + offsets[i + 1];
+        std::string& out = parts[i];
+        out.reserve(offsets[i + 1] - offsets[i] + (offsets[i + 1] - offsets[i]) / 8);
+        for (const char* line = data + offsets[i]; line < end;) {
+            const char* eol = LineEnd(line, end);
+            const char* p = line;
+            float x = 0, y = 0, z = 0;
+            if (p + 1 < eol && p[0] == 'v' && p[1] == ' ') {
+                p++;
+                ParseFloat(p, eol, x);
+                ParseFloat(p, eol, y);
+                ParseFloat(p, eol, z);
+                AppendFormat(out, "v %g %g %g\n", m[0] * x + m[4] * y + m[8] * z + m[12],
+                                                  m[1] * x + m[5] * y + m[9] * z + m[13],
+                                                  m[2] * x + m[6] * y + m[10] * z + m[14]);
+            } else {
+                out.append(line, eol);
+                out += '\n';
+            }
+            line = eol + 1;
+        }
+    });
+    return WriteFile(output, parts);
+}
+
+const std::string LoadObjTexture(const std::string& mtl_filename) {
+    std::ifstream file(mtl_filename);
+    std::string line;
+    while (std::getline(file, line)) {
+        const char* begin = SkipSpaces(line.data(), line.data() + line.size());
+        const char* end = line.data() + line.size();
+        if (Keyword(begin, end) == "map_Kd")
+            return Rest(begin + 6, end);
+    }
+    return "";
+}
+
+}  // namespace RIO
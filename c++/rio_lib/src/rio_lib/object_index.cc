@@ -0,0 +1,155 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#include "rio_lib/object_index.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace RIO {
+
+namespace {
+
+const std::string kIndexHeader = "rio_object_index 1\n";
+
+template<typename T>
+void WriteArray(std::ofstream& file, const std::vector<T>& values) {
+    const uint64_t size = values.size();
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.write(reinterpret_cast<const char*>(values.data()), size * sizeof(T));
+}
+
+template<typename T>
+const bool ReadArray(std::ifstream& file, std::vector<T>& values) {
+    uint64_t size = 0;
+    if (!file.read(reinterpret_cast<char*>(&size), sizeof(size)))
+        return false;
+    values.resize(size);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(values.data()), size * sizeof(T)));
+}
+
+void WriteStrings(std::ofstream& file, const std::vector<std::string>& strings) {
+    std::string joined{""};
+    for (const std::string& value: strings)
+        joined.append(value).push_back('\n');
+    WriteArray(file, std::vector<char>(joined.begin(), joined.end()));
+}
+
+const bool ReadStrings(std::ifstream& file, std::vector<std::string>& strings) {
+    std::vector<char> joined;
+    if (!ReadArray(file, joined))
+        return false;
+    strings.clear();
+    auto begin = joined.begin();
+    for (auto end = std::find(begin, joined.end(), '\n'); end != joined.end();
+         begin = end + 1, end = std::find(begin, joined.end(), '\n'))
+        strings.emplace_back(begin, end);
+    return true;
+}
+
+}  // namespace
+
+void GlobalObjectIndex::Build(const std::map<std::string, Scan>& scans) {
+    scan_ids_.clear();
+    labels_.clear();
+    int max_id = -1;
+    for (const auto& scan: scans) {
+        scan_ids_.push_back(scan.first);
+        for (const auto& instance: scan.second.instance2global)
+            max_id = std::max(max_id, instance.second);
+        for (const auto& instance: scan.second.instance2labels)
+            labels_.push_back(instance.second);
+    }
+    std::sort(labels_.begin(), labels_.end());
+    labels_.erase(std::unique(labels_.begin(), labels_.end()), labels_.end());
+
+    // Counting sort by global id and by label. The scans are visited in order of their
+    // id and the instances in ascending order, so every posting list stays sorted.
+    global_offsets_.assign(max_id + 2, 0);
+    label_offsets_.assign(labels_.size() + 1, 0);
+    std::vector<uint32_t> label_of_instance;
+    for (const auto& scan: scans) {
+        for (const auto& instance: scan.second.instance2global) {
+            if (instance.second >= 0)
+                global_offsets_[instance.second + 1]++;
+        }
+        for (const auto& instance: scan.second.instance2labels) {
+            const auto label = std::lower_bound(labels_.begin(), labels_.end(), instance.second);
+            label_of_instance.push_back(static_cast<uint32_t>(label - labels_.begin()));
+            label_offsets_[label_of_instance.back() + 1]++;
+        }
+    }
+    for (size_t i = 1; i < global_offsets_.size(); i++)
+        global_offsets_[i] += global_offsets_[i - 1];
+    for (size_t i = 1; i < label_offsets_.size(); i++)
+        label_offsets_[i] += label_offsets_[i - 1];
+
+    global_postings_.resize(global_offsets_.back());
+    label_postings_.resize(label_offsets_.back());
+    std::vector<uint32_t> global_cursor(global_offsets_.begin(), global_offsets_.end() - 1);
+    std::vector<uint32_t> label_cursor(label_offsets_.begin(), label_offsets_.end() - 1);
+    uint32_t scan_index = 0;
+    size_t label_index = 0;
+    for (const auto& scan: scans) {
+        for (const auto& instance: scan.second.instance2global) {
+            if (instance.second >= 0)
+                global_postings_[global_cursor[instance.second]++] = { scan_index, static_cast<uint32_t>(instance.first) };
+        }
+        for (const auto& instance: scan.second.instance2labels)
+            label_postings_[label_cursor[label_of_instance[label_index++]]++] = { scan_index, static_cast<uint32_t>(instance.first) };
+        scan_index++;
+    }
+}
+
+const bool GlobalObjectIndex::Save(const std::string& filename) const {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    file << kIndexHeader;
+    WriteStrings(file, scan_ids_);
+    WriteArray(file, global_offsets_);
+    WriteArray(file, global_postings_);
+    WriteStrings(file, labels_);
+    WriteArray(file, label_offsets_);
+    WriteArray(file, label_postings_);
+    return file.good();
+}
+
+const bool GlobalObjectIndex::Load(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    std::string header(kIndexHeader.size(), '\0');
+    if (!file.read(&header[0], header.size()) || header != kIndexHeader)
+        return false;
+    const bool success = ReadStrings(file, scan_ids_) && ReadArray(file, global_offsets_) &&
+                         ReadArray(file, global_postings_) && ReadStrings(file, labels_) &&
+                         ReadArray(file, label_offsets_) && ReadArray(file, label_postings_) &&
+                         !global_offsets_.empty() && global_offsets_.back() == global_postings_.size() &&
+                         label_offsets_.size() == labels_.size() + 1 &&
+                         label_offsets_.back() == label_postings_.size();
+    if (!success)
+        *this = GlobalObjectIndex();
+    return success;
+}
+
+const ObjectPostings GlobalObjectIndex::Find(const int global_id) const {
+    if (global_id < 0 || global_id + 1 >= static_cast<int>(global_offsets_.size()))
+        return ObjectPostings();
+    return { global_postings_.data() + global_offsets_[global_id],
+             global_postings_.data() + global_offsets_[global_id + 1] };
+}
+
+const ObjectPostings GlobalObjectIndex::Find(const std::string& label) const {
+    const auto found = std::lower_bound(labels_.begin(), labels_.end(), label);
+    if (found == labels_.end() || *found != label)
+        return ObjectPostings();
+    const size_t i = found - labels_.begin();
+    return { label_postings_.data() + label_offsets_[i], label_postings_.data() + label_offsets_[i + 1] };
+}
+
+}  // namespace RIO
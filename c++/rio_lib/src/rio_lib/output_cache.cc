@@ -0,0 +1,145 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#include "rio_lib/output_cache.h"
+
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace RIO {
+
+namespace {
+
+const std::string kKeyHeader = "rio_output_key 1";
+
+const std::string KeyFile(const std::string& output) {
+    return output + ".key";
+}
+
+const bool WriteKeyFile(const std::string& output, const std::string& content) {
+    return WriteAtomically(KeyFile(output), [&](const std::string& filename) {
+        std::ofstream file(filename);
+        file << content;
+        return file.good();
+    });
+}
+
+}  // namespace
+
+OutputKey::OutputKey(const std::string& operation, const int version):
+    operation_(operation + " " + std::to_string(version)), metadata_(HashToString(kHashSeed)) {
+}
+
+void OutputKey::AddInput(const std::string& filename) {
+    inputs_.push_back(filename);
+}
+
+void OutputKey::AddMetadata(const void* data, const size_t size) {
+    metadata_hash_ = HashBytes(&size, sizeof(size), metadata_hash_);
+    metadata_hash_ = HashBytes(data, size, metadata_hash_);
+    metadata_ = HashToString(metadata_hash_);
+}
+
+void OutputKey::AddMetadata(const std::string& value) {
+    AddMetadata(value.data(), value.size());
+}
+
+const bool GetFileState(const std::string& filename, FileState& state) {
+    struct stat buffer;
+    if (stat(filename.c_str(), &buffer) != 0)
+        return false;
+    state.size = static_cast<uint64_t>(buffer.st_size);
+#if defined(__APPLE__)
+    state.mtime = static_cast<uint64_t>(buffer.st_mtimespec.tv_sec) * 1000000000ull + buffer.st_mtimespec.tv_nsec;
+#else
+    state.mtime = static_cast<uint64_t>(buffer.st_mtim.tv_sec) * 1000000000ull + buffer.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+const std::string TemporaryFile(const std::string& output) {
+    std::ostringstream temporary;
+    temporary << output << "." << getpid() << "." << std::hash<std::thread::id>()(std::this_thread::get_id())
+              << ".tmp";
+    return temporary.str();
+}
+
+const bool IsOutputValid(const std::string& output, const OutputKey& key) {
+    std::ifstream file(KeyFile(output));
+    std::string line{""};
+    // The key file with the current state of the inputs.
+    std::ostringstream updated;
+    bool rehashed = false;
+    if (!std::getline(file, line) || line != kKeyHeader)
+        return false;
+    updated << line << "\n";
+    if (!std::getline(file, line) || line != "operation " + key.operation())
+        return false;
+    updated << line << "\n";
+    if (!std::getline(file, line) || line != "metadata " + key.metadata())
+        return false;
+    updated << line << "\n";
+    std::string tag{""};
+    uint64_t size = 0;
+    FileState state;
+    if (!std::getline(file, line) || !(std::istringstream(line) >> tag >> size) || tag != "output" ||
+        !GetFileState(output, state) || state.size != size)
+        return false;
+    updated << line << "\n";
+    for (const std::string& input: key.inputs()) {
+        // input <size> <mtime> <hash> <filename>
+        std::string hash{""}, filename{""};
+        uint64_t mtime = 0;
+        if (!std::getline(file, line))
+            return false;
+        std::istringstream entry(line);
+        if (!(entry >> tag >> size >> mtime >> hash) || tag != "input" || !std::getline(entry >> std::ws, filename) ||
+            filename != input || !GetFileState(input, state))
+            return false;
+        if (state.size == size && state.mtime == mtime) {
+            updated << line << "\n";
+            continue;
+        }
+        bool valid = false;
+        if (state.size != size || HashToString(HashFile(input, valid)) != hash || !valid)
+            return false;
+        updated << "input " << state.size << " " << state.mtime << " " << hash << " " << input << "\n";
+        rehashed = true;
+    }
+    if (std::getline(file, line))
+        return false;
+    file.close();
+    // The output stays valid if the key file can not be updated.
+    if (rehashed)
+        WriteKeyFile(output, updated.str());
+    return true;
+}
+
+const bool StoreOutputKey(const std::string& output, const OutputKey& key) {
+    FileState state;
+    if (!GetFileState(output, state))
+        return false;
+    std::ostringstream content;
+    content << kKeyHeader << "\n" << "operation " << key.operation() << "\n"
+            << "metadata " << key.metadata() << "\n" << "output " << state.size << "\n";
+    for (const std::string& input: key.inputs()) {
+        bool valid = false;
+        const uint64_t hash = HashFile(input, valid);
+        if (!valid || !GetFileState(input, state))
+            return false;
+        content << "input " << state.size << " " << state.mtime << " " << HashToString(hash) << " " << input << "\n";
+    }
+    return WriteKeyFile(output, content.str());
+}
+
+}  // namespace RIO
@@ -0,0 +1,95 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#include "rio_lib/ply_workspace.h"
+
+#include <sys/resource.h>
+
+#include "rio_lib/log.h"
+
+namespace RIO {
+
+namespace {
+
+// Counts the columns whose capacity changed between two snapshots.
+size_t CountGrowths(const std::vector<size_t>& before, const std::vector<size_t>& after) {
+    size_t growths = 0;
+    for (size_t i = 0; i < after.size(); i++) {
+        const size_t previous = (i < before.size()) ? before[i] : 0;
+        if (after[i] != previous)
+            growths++;
+    }
+    return growths;
+}
+
+}  // namespace
+
+RIOPlyData& PlyWorkspace::Ply() {
+    Track();
+    ply_.clear();
+    return ply_;
+}
+
+void PlyWorkspace::Capacities(std::vector<size_t>& capacities) const {
+    capacities = { ply_.vertices.capacity(), ply_.colors.capacity(), ply_.faces.capacity(),
+                   ply_.global_ids.capacity(), ply_.object_ids.capacity(),
+                   ply_.category_ids.capacity(), ply_.raw_nyu40.capacity(),
+                   ply_.raw_mpr40.capacity(), ply_.NYU40.capacity(),
+                   ply_.Eigen13.capacity(), ply_.RIO27.capacity() };
+}
+
+void PlyWorkspace::Track() {
+    std::vector<size_t> capacities;
+    Capacities(capacities);
+    allocations_ += CountGrowths(capacities_, capacities);
+    capacities_.swap(capacities);
+    uses_++;
+}
+
+const size_t PlyWorkspace::uses() const {
+    return uses_;
+}
+
+const size_t PlyWorkspace::allocations() const {
+    // Also count what the last user of the workspace allocated.
+    std::vector<size_t> capacities;
+    Capacities(capacities);
+    return allocations_ + CountGrowths(capacities_, capacities);
+}
+
+const size_t PlyWorkspace::reserved_bytes() const {
+    return ply_.capacity_bytes();
+}
+
+void PlyWorkspace::Report(std::ostream& out) const {
+    FlushLog();
+    out << "ply workspace: " << uses() << " uses, " << allocations() << " column allocations, "
+        << reserved_bytes() / (1024 * 1024) << " MB reserved, peak RSS "
+        << PeakResidentSetSize() / (1024 * 1024) << " MB" << std::endl;
+}
+
+PlyWorkspace& ThreadWorkspace() {
+    static thread_local PlyWorkspace workspace;
+    return workspace;
+}
+
+const size_t PeakResidentSetSize() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    // macOS reports bytes.
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    // Linux reports kilobytes.
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+}  // namespace RIO
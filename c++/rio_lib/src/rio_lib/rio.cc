@@ -1,18 +1,106 @@
 #include "rio_lib/rio.h"
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <thread>
 // #include <stdlib.h>
 
+#include "rio_lib/instance_index.h"
+#include "rio_lib/log.h"
+#include "rio_lib/obj_loader.h"
+#include "rio_lib/output_cache.h"
 #include "third_party/tinyply.h"
 
 namespace RIO {
 
-RIO::RIO(const RIOConfig& config): config_(config),
+namespace {
+
+// Threads of the parallel loaders and gathers inside an operation (0 uses all hardware
+// threads). The workers of the *Async executor already run operations in parallel, so
+// they set it to 1.
+thread_local unsigned operation_threads = 0;
+
+// Applies the rigid transformation to all positions (x y z) at once.
+void TransformPositions(const Eigen::Matrix4f& matrix, std::vector<float>& positions) {
+    Eigen::Map<Eigen::Matrix3Xf> points(positions.data(), 3, positions.size() / 3);
+    points = (matrix.block<3,3>(0,0) * points).colwise() + matrix.block<3,1>(0,3);
+}
+
+// Loads the obj of a scan. Fails (with an error) if it can not be read or if its faces
+// do not match the ones of the labels ply that the instance index was built from.
+const bool LoadScene(const std::string& filename, const InstanceIndex& index, ObjMesh& scene,
+                     const unsigned num_threads) {
+    if (!LoadObj(filename, scene, num_threads)) {
+        RIO_LOG(Error) << "can not load " << filename;
+        return false;
+    }
+    if (scene.num_faces() != index.scene_faces()) {
+        RIO_LOG(Error) << filename << " has " << scene.num_faces() << " faces but the labels ply has "
+                       << index.scene_faces();
+        return false;
+    }
+    return true;
+}
+
+// Writes the obj text of several instances into one file. The header lists the
+// instance id, the offset (relative to the end of the header) and the size in bytes.
+const bool WriteInstanceArchive(const std::string& filename, const std::vector<int>& instances,
+                                const std::vector<std::string>& objs) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    file << "rio_instance_archive 1\n" << "instances " << instances.size() << "\n";
+    size_t offset = 0;
+    for (size_t i = 0; i < instances.size(); i++) {
+        file << instances[i] << " " << offset << " " << objs[i].size() << "\n";
+        offset += objs[i].size();
+    }
+    file << "end_header\n";
+    for (const std::string& obj: objs)
+        file.write(obj.data(), obj.size());
+    return file.good();
+}
+
+// Computes an output with compute(filename) into a temporary file unless the
+// key file shows that it is up to date (if cache is set).
+template<typename Compute>
+const bool UpdateOutput(const bool cache, const std::string& output, const OutputKey& key, Compute compute) {
+    if (cache && IsOutputValid(output, key)) {
+        RIO_LOG(Info) << "up to date: " << output;
+        return true;
+    }
+    if (!WriteAtomically(output, compute))
+        return false;
+    if (cache)
+        StoreOutputKey(output, key);
+    RIO_LOG(Info) << "saved " << output;
+    return true;
+}
+
+}  // namespace
+
+RIO::RIO(const RIOConfig& config): geometry_cache_(config.geometry_cache_bytes),
+                                   config_(config),
                                    data_config_(config_.data_path),
                                    json_data_(data_config_.GetJson()),
                                    sequence_(config_.data_path, json_data_) {
     const std::string& object_json = data_config_.GetObjectJson();
     LoadObjects(object_json);
+    // The object index is stored next to objects.json and only rebuilt if it changed.
+    const std::string object_index = data_config_.GetObjectIndex();
+    OutputKey object_index_key("GlobalObjectIndex", 1);
+    object_index_key.AddInput(object_json);
+    if (!config_.cache_outputs || !IsOutputValid(object_index, object_index_key) ||
+        !object_index_.Load(object_index)) {
+        object_index_.Build(scans);
+        // The data folder may be read-only, the index is then built on every start.
+        if (config_.cache_outputs && WriteAtomically(object_index, [&](const std::string& output) {
+                return object_index_.Save(output);
+            }))
+            StoreOutputKey(object_index, object_index_key);
+    }
+    label_mapping_.Load(data_config_.GetMapping());
 }
 
 const std::string RIO::GetReference(const std::string& scan_id) const {
@@ -27,34 +115,117 @@ const bool RIO::IsReference(const std::string& scan_id) const {
     return json_data_.IsReference(scan_id);
 }
 
+const bool RIO::HasScan(const std::string& scan_id) const {
+    return json_data_.HasScan(scan_id);
+}
+
+const std::vector<std::string> RIO::GetRescans(const std::string& reference_id) const {
+    return json_data_.GetRescans(reference_id);
+}
+
+const Eigen::Matrix4f RIO::GetRescanTransform(const std::string& scan_id) const {
+    return json_data_.GetRescanTransform(scan_id);
+}
+
+std::shared_ptr<const RIOPlyData> RIO::CachedPly(const std::string& filename, bool& failed) const {
+    failed = false;
+    if (geometry_cache_.budget_bytes() == 0)
+        return nullptr;
+    bool repeated = false;
+    std::shared_ptr<const RIOPlyData> cached = geometry_cache_.Find(filename, repeated);
+    if (!cached && repeated) {
+        cached = geometry_cache_.Load(filename);
+        failed = !cached;
+    }
+    return cached;
+}
+
+const RIOPlyData* RIO::ReadPly(const std::string& filename, PlyWorkspace& workspace,
+                               std::shared_ptr<const RIOPlyData>& cached) const {
+    bool failed = false;
+    cached = CachedPly(filename, failed);
+    if (cached || failed)
+        return cached.get();
+    RIOPlyData& ply_file = workspace.Ply();
+    return (ply_file.load(filename) > 0) ? &ply_file : nullptr;
+}
+
+RIOPlyData* RIO::CopyPly(const std::string& filename, PlyWorkspace& workspace) const {
+    bool failed = false;
+    const std::shared_ptr<const RIOPlyData> cached = CachedPly(filename, failed);
+    if (failed)
+        return nullptr;
+    RIOPlyData& ply_file = workspace.Ply();
+    // Copy on write, the workspace keeps its capacity.
+    if (cached)
+        ply_file = *cached;
+    else if (ply_file.load(filename) == 0)
+        return nullptr;
+    return &ply_file;
+}
+
+void RIO::Preload(const std::string& scan_id) const {
+    if (geometry_cache_.budget_bytes() > 0)
+        geometry_cache_.Get(data_config_.GetInstance(scan_id));
+}
+
+void RIO::Evict(const std::string& scan_id) const {
+    geometry_cache_.Evict(data_config_.GetInstance(scan_id));
+}
+
 const bool RIO::ReSavePLYASCII(const std::string& scan_id) const {
-    RIOPlyData ply_file;
-    const uint32_t vertices = ply_file.load(data_config_.GetInstance(scan_id));
-    ply_file.save(data_config_.GetInstance(scan_id, ".ascii"), true);
-    return (vertices > 0);
+    PlyWorkspace& workspace = ThreadWorkspace();
+    return ReSavePLYASCII(scan_id, workspace);
+}
+
+const bool RIO::ReSavePLYASCII(const std::string& scan_id, PlyWorkspace& workspace) const {
+    std::shared_ptr<const RIOPlyData> cached;
+    const RIOPlyData* ply_file = ReadPly(data_config_.GetInstance(scan_id), workspace, cached);
+    if (ply_file == nullptr || !ply_file->save(data_config_.GetInstance(scan_id, ".ascii"), true))
+        return false;
+    RIO_LOG(Info) << "saved " << data_config_.GetInstance(scan_id, ".ascii");
+    return true;
 }
 
 const bool RIO::Transform2Reference(const std::string& scan_id) const {
+    PlyWorkspace& workspace = ThreadWorkspace();
+    return Transform2Reference(scan_id, workspace);
+}
+
+const bool RIO::Transform2Reference(const std::string& scan_id, PlyWorkspace& workspace) const {
     if (json_data_.IsReference(scan_id)) {
-        std::cout << "Warning: scan ID is a reference!" << std::endl;
+        RIO_LOG(Warning) << "scan ID is a reference!";
         return false;
     }
+    // Both outputs depend on the input file and the rescan transformation of 3RScan.json.
+    const Eigen::Matrix4f matrix = json_data_.GetRescanTransform(scan_id);
+    OutputKey ply_key("Transform2Reference.ply", 1);
+    ply_key.AddInput(data_config_.GetInstance(scan_id));
+    ply_key.AddMetadata(matrix.data(), sizeof(float) * matrix.size());
+    OutputKey obj_key("Transform2Reference.obj", 1);
+    obj_key.AddInput(data_config_.GetMesh(scan_id));
+    obj_key.AddMetadata(matrix.data(), sizeof(float) * matrix.size());
     // Transform *.ply (labels file)
-    const bool ply_success = TransformPly2Reference(scan_id,
-                                                    data_config_.GetInstance(scan_id),
-                                                    data_config_.GetInstance(scan_id, ".align"));
+    const bool ply_success = UpdateOutput(config_.cache_outputs, data_config_.GetInstance(scan_id, ".align"),
+                                          ply_key, [&](const std::string& output) {
+        return TransformPly2Reference(scan_id, data_config_.GetInstance(scan_id), output, workspace);
+    });
     // Transform *.obj file (3D model)
-    const bool obj_success = TransformObj2Reference(scan_id,
-                                                    data_config_.GetMesh(scan_id),
-                                                    data_config_.GetMesh(scan_id, ".align"));
+    const bool obj_success = UpdateOutput(config_.cache_outputs, data_config_.GetMesh(scan_id, ".align"),
+                                          obj_key, [&](const std::string& output) {
+        return TransformObj2Reference(scan_id, data_config_.GetMesh(scan_id), output);
+    });
     return ply_success && obj_success;
 }
 
 bool RIO::TransformPly2Reference(const std::string& scan_id,
-                                 const std::string& input, const std::string& output) const {
-    std::ifstream ss(input, std::ios::binary);
-    RIOPlyData ply_file;
-    const uint32_t vertices = ply_file.load(input);
+                                 const std::string& input, const std::string& output,
+                                 PlyWorkspace& workspace) const {
+    RIOPlyData* ply = CopyPly(input, workspace);
+    if (ply == nullptr)
+        return false;
+    RIOPlyData& ply_file = *ply;
+    const size_t vertices = ply_file.vertices.size() / 3;
     const Eigen::Matrix4f& matrix = json_data_.GetRescanTransform(scan_id);
     for (int i = 0; i < vertices; i++) {
         const Eigen::Vector4f vertex(ply_file.vertices[3*i], ply_file.vertices[3*i+1], ply_file.vertices[3*i+2], 1);
@@ -63,68 +234,95 @@ bool RIO::TransformPly2Reference(const std::string& scan_id,
         ply_file.vertices[3*i+1] = vertex_transformed(1);
         ply_file.vertices[3*i+2] = vertex_transformed(2);
     }
-    ply_file.save(output, true);
-    return vertices > 0;
+    return (vertices > 0) && ply_file.save(output, true);
 }
 
 bool RIO::TransformObj2Reference(const std::string& scan_id,
                                  const std::string& input,
                                  const std::string& output) const {
-    std::ifstream obj_file_in(input);
-    std::ofstream obj_file_out(output);
-
-    std::string line;
-    std::string tag;
-    std::vector<std::string> faces;
-    const Eigen::Matrix4f& matrix = json_data_.GetRescanTransform(scan_id);
-    Eigen::Vector4f vertex(0,0,0,1);
-    if (obj_file_in.is_open()) {
-        if (obj_file_out.is_open()) {
-            while (getline(obj_file_in, line)) {
-                std::string type = line.substr(0, line.find(" "));
-                if (type == "v") {
-                    std::istringstream iss(line);
-                    iss >> tag >> vertex(0) >> vertex(1) >> vertex(2);
-                    Eigen::Vector4f vertex_transformed = matrix * vertex;
-                    obj_file_out << tag << " "
-                                 << vertex_transformed(0) << " "
-                                 << vertex_transformed(1) << " "
-                                 << vertex_transformed(2) << std::endl;
-                } else obj_file_out << line << std::endl;
-            }
-            obj_file_out.close();
-            obj_file_in.close();
-            std::cout << "saved file: " << output << std::endl;
-            return true;
-        }
-    }
-    return false;
+    const Eigen::Matrix4f matrix = json_data_.GetRescanTransform(scan_id);
+    // Only the vertex lines change, everything else is copied as is.
+    return TransformObj(input, output, matrix.data(), operation_threads);
 }
 
 const bool RIO::RemapLabelsPly(const std::string& scan_id) const {
+    PlyWorkspace& workspace = ThreadWorkspace();
+    return RemapLabelsPly(scan_id, workspace);
+}
+
+const bool RIO::RemapLabelsPly(const std::string& scan_id, PlyWorkspace& workspace) const {
     if (scans.find(scan_id) != scans.end()) {
         const Scan& scan = scans.at(scan_id);
-        RIOPlyData ply_file;
-        const uint32_t vertices = ply_file.load(data_config_.GetInstance(scan_id));
-        for (int i = 0; i < vertices; i++) {
-            const int instance_id = ply_file.object_ids[i];
-            int global_id = 0;
-            if (scan.instance2global.find(instance_id) != scan.instance2global.end()) {
-                global_id = scan.instance2global.at(instance_id);
-            }
-            ply_file.global_ids.push_back(global_id);
+        return UpdateOutput(config_.cache_outputs, data_config_.GetInstance(scan_id, ".global"),
+                            RemapLabelsKey(scan_id), [&](const std::string& output) {
+            RIOPlyData* ply = CopyPly(data_config_.GetInstance(scan_id), workspace);
+            if (ply == nullptr)
+                return false;
+            RIOPlyData& ply_file = *ply;
+            const size_t vertices = ply_file.vertices.size() / 3;
+            ply_file.global_ids.resize(vertices);
+            Gather(ply_file.object_ids, scan.instance2global_table, 1, ply_file.global_ids.data(), operation_threads);
             // also remap colors
-            ply_file.colors[3*i] = globalId2color[global_id](0);
-            ply_file.colors[3*i+1] = globalId2color[global_id](1);
-            ply_file.colors[3*i+2] = globalId2color[global_id](2);
-        }
-        std::cout << "save " << data_config_.GetInstance(scan_id, ".global") << std::endl;
-        ply_file.save(data_config_.GetInstance(scan_id, ".global"), true);
-        return vertices > 0;
+            Gather(ply_file.global_ids, globalId2rgb, 3, ply_file.colors.data(), operation_threads);
+            return (vertices > 0) && ply_file.save(output, true);
+        });
     }
     return false;
 }
 
+const OutputKey RIO::RemapLabelsKey(const std::string& scan_id) const {
+    // The output depends on the instances of objects.json and the colors.
+    OutputKey key("RemapLabelsPly", 1);
+    key.AddInput(data_config_.GetInstance(scan_id));
+    const auto scan = scans.find(scan_id);
+    if (scan != scans.end()) {
+        const std::vector<uint16_t>& table = scan->second.instance2global_table;
+        key.AddMetadata(table.data(), sizeof(uint16_t) * table.size());
+    }
+    key.AddMetadata(globalId2rgb.data(), globalId2rgb.size());
+    return key;
+}
+
+const bool RIO::RemapLabelsPly(const std::string& scan_id, const LabelSet set) const {
+    PlyWorkspace& workspace = ThreadWorkspace();
+    return RemapLabelsPly(scan_id, set, workspace);
+}
+
+const bool RIO::RemapLabelsPly(const std::string& scan_id, const LabelSet set,
+                               PlyWorkspace& workspace) const {
+    if (scans.find(scan_id) == scans.end() || label_mapping_.empty())
+        return false;
+    // Combine instance -> global -> class into one table so that every vertex needs one lookup.
+    const std::vector<uint16_t>& instance2global = scans.at(scan_id).instance2global_table;
+    std::vector<uint8_t> instance2class(instance2global.size());
+    Gather(instance2global, label_mapping_.Table(set), 1, instance2class.data(), operation_threads);
+    std::string suffix = "." + LabelSetName(set);
+    std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::tolower);
+    OutputKey key("RemapLabelsPly." + LabelSetName(set), 1);
+    key.AddInput(data_config_.GetInstance(scan_id));
+    key.AddMetadata(instance2class.data(), instance2class.size());
+    key.AddMetadata(globalId2rgb.data(), globalId2rgb.size());
+    return UpdateOutput(config_.cache_outputs, data_config_.GetInstance(scan_id, suffix),
+                        key, [&](const std::string& output) {
+        RIOPlyData* ply = CopyPly(data_config_.GetInstance(scan_id), workspace);
+        if (ply == nullptr)
+            return false;
+        RIOPlyData& ply_file = *ply;
+        const size_t vertices = ply_file.vertices.size() / 3;
+        // v1 files only have a NYU40 column.
+        if (!ply_file.v2 && set != LabelSet::NYU40)
+            return false;
+        std::vector<uint8_t>& column = !ply_file.v2 ? ply_file.raw_nyu40 :
+                                       (set == LabelSet::NYU40) ? ply_file.NYU40 :
+                                       (set == LabelSet::Eigen13) ? ply_file.Eigen13 : ply_file.RIO27;
+        column.resize(vertices);
+        Gather(ply_file.object_ids, instance2class, 1, column.data(), operation_threads);
+        // the classes are colored like the global ids with the same value.
+        Gather(column, globalId2rgb, 3, ply_file.colors.data(), operation_threads);
+        return (vertices > 0) && ply_file.save(output, true);
+    });
+}
+
 const Eigen::Matrix4f RIO::GetCameraPose(const std::string& scan_id, 
                                          const int frame_id,
                                          const bool normalize2reference,
@@ -148,16 +346,67 @@ const bool RIO::Backproject(const std::string& scan_id, const int frame_id,
     return sequence_.Backproject(scan_id, frame_id, normalized2reference);
 }
 
+const int RIO::GetNumFrames(const std::string& scan_id) const {
+    return sequence_.GetNumFrames(scan_id);
+}
+
+const int RIO::GetCameraPoses(const std::string& scan_id, Eigen::Matrix4Xf& poses,
+                              const bool normalize2reference, const bool mm) const {
+    return sequence_.GetPoses(scan_id, normalize2reference, mm, poses);
+}
+
+template<typename Operation>
+std::future<bool> RIO::Async(Operation operation) const {
+    std::call_once(executor_once_, [this]() {
+        const unsigned threads = config_.async_threads;
+        executor_.reset(new ThreadPool((threads == 0) ? DefaultThreads() : threads));
+    });
+    // The blocking calls use the workspace of the worker thread and run their loaders
+    // and gathers on it alone, the executor is already busy with other operations.
+    const auto task = std::make_shared<std::packaged_task<bool()>>(operation);
+    std::future<bool> result = task->get_future();
+    executor_->Submit([task]() {
+        operation_threads = 1;
+        (*task)();
+    });
+    return result;
+}
+
+std::future<bool> RIO::ReSavePLYASCIIAsync(const std::string& scan_id) const {
+    return Async([this, scan_id]() { return ReSavePLYASCII(scan_id); });
+}
+
+std::future<bool> RIO::Transform2ReferenceAsync(const std::string& scan_id) const {
+    return Async([this, scan_id]() { return Transform2Reference(scan_id); });
+}
+
+std::future<bool> RIO::RemapLabelsPlyAsync(const std::string& scan_id) const {
+    return Async([this, scan_id]() { return RemapLabelsPly(scan_id); });
+}
+
+std::future<bool> RIO::TransformInstanceAsync(const std::string& scan_id, const int instance) const {
+    return Async([this, scan_id, instance]() { return TransformInstance(scan_id, instance); });
+}
+
+std::future<bool> RIO::BackprojectAsync(const std::string& scan_id, const int frame_id,
+                                        const bool normalized2reference) const {
+    return Async([this, scan_id, frame_id, normalized2reference]() {
+        return Backproject(scan_id, frame_id, normalized2reference);
+    });
+}
+
 void RIO::InitGlobalId2Color(const int size) {
     // let's fix the seed to make sure we always get the same colors.
     std::srand(0);
     // instance with index 0 is invalid.
-    globalId2color.push_back(Eigen::Vector3i(0,0,0));
+    globalId2rgb.assign(3, 0);
+    globalId2rgb.reserve(3 * (size + 1));
     for (int i = 0; i < size; i++) {
     	const int b = std::rand() % (color_range_from - color_range_to) + color_range_from;
         const int g = std::rand() % (color_range_from - color_range_to) + color_range_from;
         const int r = std::rand() % (color_range_from - color_range_to) + color_range_from;
-        globalId2color.push_back(Eigen::Vector3i(r,g,b));
+        globalId2rgb.insert(globalId2rgb.end(), { static_cast<uint8_t>(r), static_cast<uint8_t>(g),
+                                                  static_cast<uint8_t>(b) });
     }
 }
 
@@ -179,6 +428,10 @@ const bool RIO::LoadObjects(const std::string& objects) {
             scan.instance2labels[id] = obj["label"].string_value();
             scan.instance2global[id] = global_id;
         }
+        const int max_id = scan.instance2global.empty() ? 0 : scan.instance2global.rbegin()->first;
+        scan.instance2global_table.assign(max_id + 1, 0);
+        for (const auto& instance: scan.instance2global)
+            scan.instance2global_table[instance.first] = static_cast<uint16_t>(instance.second);
         const std::string& scan_id = scan_json["scan"].string_value();
         scans[scan_id] = scan;
     }
@@ -187,72 +440,111 @@ const bool RIO::LoadObjects(const std::string& objects) {
 
 void RIO::PrintSemanticLabels(const std::string& scan_id) const {
     // Writes semantic labels to the console.
+    FlushLog();
     if (scans.find(scan_id) != scans.end()) {
         const auto& scan = scans.at(scan_id);
         for (const auto instance: scan.instance2labels) {
             std::cout << instance.first << ": "
                       << scan.instance2labels.at(instance.first)
-                      << " (" << scan.instance2global.at(instance.first) << ")" << std::endl;
+                      << " (" << scan.instance2global.at(instance.first) << ")" << "\n";
         }
     }
 }
 
 const bool RIO::TransformInstance(const std::string& scan_id, const int& instance) const {
-    RIOPlyData ply_file;
-    ply_file.load(data_config_.GetInstance(scan_id));
-    
-    std::vector<int> vertices_to_keep;
-    std::vector<int> faces_to_keep;
-    const int faces_size = static_cast<int>(ply_file.faces.size() / 3);
-    for (int i = 0; i < faces_size; i++) {
-        // if any of the vertices of that face belong to the label we keep the face.
-        if ((ply_file.object_ids[ply_file.faces[3*i]] == instance) ||
-            (ply_file.object_ids[ply_file.faces[3*i+1]] == instance) ||
-            (ply_file.object_ids[ply_file.faces[3*i+2]] == instance)) {
-            faces_to_keep.push_back(i);
-        }
-    }
+    PlyWorkspace& workspace = ThreadWorkspace();
+    return TransformInstance(scan_id, instance, workspace);
+}
+
+const bool RIO::TransformInstance(const std::string& scan_id, const int& instance,
+                                  PlyWorkspace& workspace) const {
+    std::shared_ptr<const RIOPlyData> cached;
+    const RIOPlyData* ply_file = ReadPly(data_config_.GetInstance(scan_id), workspace, cached);
+    if (ply_file == nullptr)
+        return false;
+    // A face belongs to the instance if any of its vertices belongs to it.
+    InstanceIndex index;
+    index.Build(*ply_file);
     // let's get the matrix that transforms the rigid objects.
     Eigen::Matrix4f matrix = json_data_.GetRigidTransform(scan_id, instance);
-    std::cout << matrix << std::endl;
-    std::ifstream obj_file_in(data_config_.GetMesh(scan_id));
-    std::ofstream obj_file_out(data_config_.GetMesh(scan_id, ".align.instance." + std::to_string(instance)));
-    Eigen::Vector4f vertex(0,0,0,1);
-    std::string tag;
-    if (!faces_to_keep.empty()) {
-        std::string line;
-        std::vector<std::string> faces;
-        if (obj_file_in.is_open()) {
-            if (obj_file_out.is_open()) {
-                // TODO this can be done easier
-                while (getline(obj_file_in, line)) {
-                    std::string type = line.substr(0, line.find(" "));
-                    if (type == "f")
-                        faces.push_back(line);
-                    else if (type == "v") {
-                        // TODO We keep all the vertices
-                        // (not ideal but that helps to avoid re-mapping the faces)
-                        std::istringstream iss(line);
-                        iss >> tag >> vertex(0) >> vertex(1) >> vertex(2);
-                        Eigen::Vector4f vertex_transformed = matrix * vertex;
-                        obj_file_out << tag << " "
-                                     << vertex_transformed(0) << " "
-                                     << vertex_transformed(1) << " "
-                                     << vertex_transformed(2) << std::endl;
-                    }
-                    else obj_file_out << line << std::endl;
-                }
-                // Saves the faces we want to keep.
-                for (const int face_id: faces_to_keep) {
-                    obj_file_out << faces[face_id] << std::endl;
-                }
-                obj_file_out.close();
-                obj_file_in.close();
+    RIO_LOG(Debug) << "instance " << instance << " transformation:\n" << matrix;
+    if (index.num_faces(instance) == 0)
+        return false;
+    ObjMesh scene;
+    if (!LoadScene(data_config_.GetMesh(scan_id), index, scene, operation_threads))
+        return false;
+    // Only the vertices of the instance are kept and its faces are re-indexed.
+    ObjMesh mesh;
+    InstanceExtractor extractor;
+    extractor.Extract(scene, index, instance, mesh);
+    TransformPositions(matrix, mesh.positions);
+    const std::string output = data_config_.GetMesh(scan_id, ".align.instance." + std::to_string(instance));
+    if (!SaveObj(output, mesh)) {
+        RIO_LOG(Error) << "can not save " << output;
+        return false;
+    }
+    RIO_LOG(Info) << "saved " << output;
+    return true;
+}
+
+const bool RIO::TransformAllInstances(const std::string& scan_id,
+                                      const InstanceExportOptions& options) const {
+    PlyWorkspace& workspace = ThreadWorkspace();
+    return TransformAllInstances(scan_id, options, workspace);
+}
+
+const bool RIO::TransformAllInstances(const std::string& scan_id, const InstanceExportOptions& options,
+                                      PlyWorkspace& workspace) const {
+    std::shared_ptr<const RIOPlyData> cached;
+    const RIOPlyData* ply_file = ReadPly(data_config_.GetInstance(scan_id), workspace, cached);
+    if (ply_file == nullptr)
+        return false;
+    InstanceIndex index;
+    index.Build(*ply_file);
+    ObjMesh scene;
+    if (!LoadScene(data_config_.GetMesh(scan_id), index, scene, options.num_threads))
+        return false;
+    // objectId 0 is not an object.
+    std::vector<int> instances = index.instances();
+    instances.erase(std::remove(instances.begin(), instances.end(), 0), instances.end());
+    if (instances.empty())
+        return false;
+    // Text of every instance if they are written into one archive.
+    std::vector<std::string> objs(options.single_archive ? instances.size() : 0);
+    std::atomic<size_t> next_instance{0};
+    std::atomic<bool> success{true};
+    const auto export_instances = [&]() {
+        InstanceExtractor extractor;
+        ObjMesh mesh;
+        for (size_t i = next_instance++; i < instances.size(); i = next_instance++) {
+            const int instance = instances[i];
+            extractor.Extract(scene, index, instance, mesh);
+            TransformPositions(json_data_.GetRigidTransform(scan_id, instance), mesh.positions);
+            if (options.single_archive) {
+                FormatObj(mesh, objs[i]);
+                continue;
+            }
+            const std::string output = data_config_.GetMesh(scan_id, ".align.instance." + std::to_string(instance));
+            if (!SaveObj(output, mesh)) {
+                RIO_LOG(Error) << "can not save " << output;
+                success = false;
             }
         }
-        return true;
+    };
+    const size_t num_threads = std::min<size_t>(instances.size(),
+        (options.num_threads == 0) ? DefaultThreads() : options.num_threads);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_threads; i++)
+        threads.emplace_back(export_instances);
+    export_instances();
+    for (std::thread& thread: threads)
+        thread.join();
+    if (options.single_archive) {
+        success = WriteInstanceArchive(data_config_.GetInstanceArchive(scan_id), instances, objs);
+        if (!success)
+            RIO_LOG(Error) << "can not save " << data_config_.GetInstanceArchive(scan_id);
     }
-    return false;
+    return success;
 }
 
 }  // namespace rio
@@ -0,0 +1,158 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "data_config.h"
+#include "frame_config.h"
+#include "rio.h"
+
+namespace RIO {
+
+// Operations that RIO::Batch runs on every scan. AlignPoses writes the poses of all
+// frames aligned to the reference (like rio_align_poses), Backproject writes the
+// point cloud of every frame.
+enum class BatchOperation { Transform2Reference, RemapLabelsPly, ReSavePLYASCII, AlignPoses, Backproject };
+
+const std::string BatchOperationName(const BatchOperation operation);
+// Parses the name of an operation (as returned by BatchOperationName), returns false if unknown.
+const bool ParseBatchOperation(const std::string& name, BatchOperation& operation);
+
+struct BatchOptions {
+    std::vector<BatchOperation> operations;
+    // Number of worker threads (0 uses all hardware threads).
+    unsigned num_threads{0};
+    // The per-frame operations are split into tasks of this many frames.
+    int frames_per_task{64};
+    // Folder (in data_path/scan_id) that AlignPoses writes the poses to.
+    std::string pose_folder{"sequence"};
+    // Backproject the frames in the coordinate system of the reference.
+    bool backproject2reference{false};
+    // Only runs the scans of shard `shard` of `num_shards` (see Batch::Shard).
+    int shard{0};
+    int num_shards{1};
+    // Folder of the journals that record completed work, empty to disable resuming.
+    std::string journal_folder{""};
+};
+
+struct BatchStats {
+    size_t scans{0};
+    size_t tasks{0};
+    size_t failed{0};
+    // Tasks that were skipped since the journal lists them as completed.
+    size_t skipped{0};
+    size_t frames{0};
+    // Estimated cost (bytes of input) of all tasks.
+    size_t bytes{0};
+    size_t steals{0};
+    size_t workspace_allocations{0};
+    double seconds{0};
+    // Prints the throughput of the run.
+    void Print(std::ostream& out) const;
+};
+
+// Reads a scan list or split file (one scan id per line, empty lines and lines
+// starting with # are skipped).
+const bool ReadScanList(const std::string& filename, std::vector<std::string>& scan_ids);
+
+// Scans of a list that belong to the same reference scene.
+struct ReferenceGroup {
+    std::string reference_id{""};
+    // True if the reference itself is in the list.
+    bool has_reference{false};
+    // Rescans of the reference that are in the list (in the order of 3RScan.json).
+    std::vector<std::string> rescans;
+};
+
+// Groups scans by their reference, groups are ordered by reference id. Scans that
+// 3RScan.json does not list are skipped with a warning.
+const std::vector<ReferenceGroup> GroupByReference(const RIO& rio, const std::vector<std::string>& scan_ids);
+
+// Parses a shard given as "i/N" (0 <= i < N).
+const bool ParseShard(const std::string& value, int& shard, int& num_shards);
+
+// Input hash of a task whose inputs can not be read, it is never journaled.
+constexpr uint64_t kInvalidInputHash = 0;
+
+// Record of the (scan, operation) pairs that a shard completed, one line
+// "<scan_id> <operation> <input hash>" per entry. Every shard appends to its own
+// file in the journal folder, so processes only need a shared filesystem and never
+// write to the same file. MergeJournals() combines the shard journals; entries of
+// both the shard and the merged journal count as completed.
+class BatchJournal {
+public:
+    BatchJournal(const std::string& folder, const int shard, const int num_shards);
+    // Reads the completed entries and opens the shard journal for appending.
+    const bool Open();
+    const bool Contains(const std::string& scan_id, const BatchOperation operation, const uint64_t hash) const;
+    // Appends an entry and flushes it, can be called from several threads.
+    void Record(const std::string& scan_id, const BatchOperation operation, const uint64_t hash);
+
+    static const std::string ShardFile(const std::string& folder, const int shard, const int num_shards);
+    static const std::string MergedFile(const std::string& folder);
+private:
+    const std::string folder_;
+    const int shard_;
+    const int num_shards_;
+    std::set<std::string> completed_;
+    std::mutex mutex_;
+    std::ofstream file_;
+};
+
+// Writes the union of the journals of all shards (and of an existing merged journal)
+// to the merged journal of the folder.
+const bool MergeJournals(const std::string& folder, const int num_shards);
+
+// Runs a set of operations on many scans with one RIO instance. Every (scan, operation)
+// pair is a task; the per-frame operations split into frame ranges that other
+// workers can steal. Tasks are submitted in the order of decreasing estimated cost
+// so that the largest scans do not end up last. Each worker reuses one PlyWorkspace.
+class Batch {
+public:
+    Batch(const RIO& rio, const RIOConfig& config);
+    // Estimated cost of an operation on a scan in bytes of input.
+    const size_t Cost(const std::string& scan_id, const BatchOperation operation) const;
+    // Splits the scans into num_shards shards with about the same number of vertices and
+    // frames (greedy, largest scan first) and returns the scans of one shard. The split
+    // only depends on the data, so every process computes the same shards.
+    const std::vector<std::string> Shard(const std::vector<std::string>& scan_ids,
+                                         const BatchOptions& options) const;
+    // Hash of the input files (and options) of an operation on a scan, kInvalidInputHash
+    // if an input can not be read.
+    const uint64_t InputHash(const std::string& scan_id, const BatchOperation operation,
+                             const BatchOptions& options) const;
+    // Runs the operations on the scans of options.shard. With a journal folder, work that
+    // is listed with the same input hash is skipped and completed work is recorded.
+    const BatchStats Run(const std::vector<std::string>& scan_ids, const BatchOptions& options) const;
+    // Calls process once per reference group of the scans (see GroupByReference()) on a
+    // pool of num_threads workers, largest group first. A group runs in one task, so jobs
+    // that compare rescans with their reference (e.g. change detection) can load the
+    // reference geometry once and stream the rescans against it. Returns the number of
+    // groups for which process returned false or threw an exception.
+    const size_t ForEachReference(const std::vector<std::string>& scan_ids,
+                                  const std::function<bool(const ReferenceGroup&)>& process,
+                                  const unsigned num_threads = 0) const;
+private:
+    const RIO& rio_;
+    const DataConfig data_config_;
+    const FrameConfig frame_config_;
+    const size_t Cost(const std::string& scan_id, const BatchOperation operation, const int frames) const;
+};
+
+}  // namespace RIO
@@ -12,6 +12,7 @@
 #include <Eigen/Dense>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "third_party/json11.hpp"
 
@@ -22,6 +23,8 @@ class Data {
 private:
     // Maps a scan id to the corresponding reference id
     std::map<std::string, std::string> scan2references{};
+    // Maps a reference id to its rescans (in the order of the json file).
+    std::map<std::string, std::vector<std::string>> reference2rescans{};
     class ReScan {
     public:
         // scan id of the corresponding reference.
@@ -45,7 +48,12 @@ public:
     const std::string GetReference(const std::string& scan_id) const;
     const bool IsRescan(const std::string& scan_id) const;
     const bool IsReference(const std::string& scan_id) const;
+    // True if the json lists the scan as a reference or a rescan.
+    const bool HasScan(const std::string& scan_id) const;
     const Eigen::Matrix4f GetRigidTransform(const std::string& scan_id, const int& instance) const;
     const Eigen::Matrix4f GetRescanTransform(const std::string& scan_id) const;
     const std::map<std::string, std::string>& GetScan2References() const;
+    // Rescans of a reference, empty if scan_id is not a reference or has no rescans.
+    const std::vector<std::string>& GetRescans(const std::string& reference_id) const;
+    const std::map<std::string, std::vector<std::string>>& GetReference2Rescans() const;
 };
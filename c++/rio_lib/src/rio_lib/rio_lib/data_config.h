@@ -15,6 +15,8 @@ struct DataConfig {
     const std::string base_path{""};
     const std::string json_file{"3RScan.json"};
     const std::string objects_json_file{"objects.json"};
+    // 3RScan class mapping exported as csv (see data/mapping.txt), optional.
+    const std::string mapping_file{"mapping.csv"};
     
     const std::string mesh{"mesh.refined.v2"};
     const std::string texture{"mesh.refined_0.png"};
@@ -28,6 +30,15 @@ struct DataConfig {
         return base_path + "/" + objects_json_file;
     }
     
+    // Inverted object index cached next to objects.json, see GlobalObjectIndex.
+    const std::string GetObjectIndex() const {
+        return base_path + "/" + objects_json_file + ".index";
+    }
+
+    const std::string GetMapping() const {
+        return base_path + "/" + mapping_file;
+    }
+
     const std::string GetJson() const {
         return base_path + "/" + json_file;
     }
@@ -40,6 +51,11 @@ struct DataConfig {
         return base_path + "/" + scan_id + "/" + mesh + suffix + ".obj";
     }
     
+    // Archive with the aligned meshes of all instances, see RIO::TransformAllInstances().
+    const std::string GetInstanceArchive(const std::string& scan_id) const {
+        return base_path + "/" + scan_id + "/" + mesh + ".align.instances.archive";
+    }
+
     const std::string GetInstance(const std::string& scan_id, const std::string suffix = "") const {
         return base_path + "/" + scan_id + "/" + instances + suffix + ".ply";
     }
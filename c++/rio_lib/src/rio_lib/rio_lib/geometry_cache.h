@@ -0,0 +1,71 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "output_cache.h"
+#include "types.h"
+
+namespace RIO {
+
+// Least recently used cache of parsed labels ply files with a memory budget.
+// Entries are immutable and shared, an operation that changes the geometry copies
+// it first (see RIO), so an evicted entry stays valid for everyone still using it.
+// An entry is only returned while the size and modification time of its file are the
+// ones it was loaded with. Can be used from several threads.
+class GeometryCache {
+public:
+    // A budget of 0 disables the cache.
+    GeometryCache(const size_t budget_bytes);
+    // Returns the parsed file if it is cached, nullptr otherwise. A file that is used
+    // once is not worth a copy in the cache, so on a miss repeated is only set if the
+    // file was requested before (with the same size and modification time).
+    std::shared_ptr<const RIOPlyData> Find(const std::string& filename, bool& repeated);
+    // Parses the file and caches it. Returns nullptr if the file has no vertices.
+    std::shared_ptr<const RIOPlyData> Load(const std::string& filename);
+    // Returns the parsed file, loads it on a miss (e.g. to preload a scan).
+    std::shared_ptr<const RIOPlyData> Get(const std::string& filename);
+    const bool Contains(const std::string& filename) const;
+    void Evict(const std::string& filename);
+    void Clear();
+
+    const size_t budget_bytes() const { return budget_bytes_; }
+    const size_t bytes() const;
+    const size_t hits() const;
+    const size_t misses() const;
+private:
+    struct Entry {
+        std::string filename;
+        FileState state;
+        std::shared_ptr<const RIOPlyData> ply;
+    };
+    const size_t budget_bytes_;
+    mutable std::mutex mutex_;
+    // Most recently used entry first.
+    std::list<Entry> entries_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> lookup_;
+    // Files that missed once and were parsed by the caller.
+    std::unordered_map<std::string, FileState> requested_;
+    size_t bytes_{0};
+    size_t hits_{0};
+    size_t misses_{0};
+    // Removes the least recently used entries until the budget is met, expects mutex_ to be held.
+    void Shrink();
+    // Removes an entry, expects mutex_ to be held.
+    void Erase(std::unordered_map<std::string, std::list<Entry>::iterator>::iterator entry);
+};
+
+}  // namespace RIO
@@ -0,0 +1,27 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace RIO {
+
+// 64 bit FNV-1a, hash is the value to continue from.
+constexpr uint64_t kHashSeed = 14695981039346656037ull;
+const uint64_t HashBytes(const void* data, const size_t size, uint64_t hash = kHashSeed);
+const uint64_t HashString(const std::string& value, uint64_t hash = kHashSeed);
+// Hashes the content of a file, valid is false if the file could not be read.
+const uint64_t HashFile(const std::string& filename, bool& valid, uint64_t hash = kHashSeed);
+// 16 digit hex representation of a hash.
+const std::string HashToString(const uint64_t hash);
+
+}  // namespace RIO
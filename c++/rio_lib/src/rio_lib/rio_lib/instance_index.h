@@ -0,0 +1,66 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "obj_loader.h"
+#include "types.h"
+
+namespace RIO {
+
+// Groups the faces of a scan by instance (objectId of the labels ply). A face
+// belongs to every instance that owns at least one of its vertices. The index
+// is built with a counting sort, so the faces of one instance are stored
+// contiguously and in their original order.
+class InstanceIndex {
+public:
+    // Builds the index from the objectId and face columns of a labels ply.
+    void Build(const RIOPlyData& ply);
+    void Build(const std::vector<uint16_t>& object_ids, const std::vector<uint32_t>& faces);
+    // Faces of the given instance as [begin, end).
+    const uint32_t* begin(const int instance) const;
+    const uint32_t* end(const int instance) const;
+    const size_t num_faces(const int instance) const;
+    // Instance ids that own at least one face (in ascending order).
+    const std::vector<int> instances() const;
+    // Number of faces of the scan the index was built from.
+    const size_t scene_faces() const;
+private:
+    // offsets_[i] is the first entry of instance i in faces_ (size: max id + 2).
+    std::vector<uint32_t> offsets_;
+    std::vector<uint32_t> faces_;
+    size_t scene_faces_{0};
+};
+
+// Copies the faces of one instance out of a scene mesh whose faces correspond to
+// the faces of the labels ply. Only the referenced positions, uvs and normals are
+// kept and the faces are re-indexed. The lookup tables are reused between calls
+// (invalidated with a generation counter instead of being cleared), so one
+// extraction takes time proportional to the size of the instance.
+class InstanceExtractor {
+public:
+    void Extract(const ObjMesh& scene, const InstanceIndex& index, const int instance, ObjMesh& mesh);
+private:
+    struct Remap {
+        std::vector<uint32_t> generation;
+        std::vector<uint32_t> target;
+        // Returns the new index of element i, count is the number of elements mapped so far.
+        const uint32_t Map(const uint32_t i, const uint32_t current, uint32_t& count, bool& added);
+        void Reserve(const size_t size);
+    };
+    uint32_t generation_{0};
+    Remap positions_;
+    Remap uvs_;
+    Remap normals_;
+};
+
+}  // namespace RIO
@@ -0,0 +1,76 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.h"
+
+namespace RIO {
+
+// Semantic label sets of the v2 ply files.
+enum class LabelSet { NYU40, Eigen13, RIO27 };
+
+// Name of the label set as used for the ply property (e.g. "NYU40").
+const std::string LabelSetName(const LabelSet set);
+
+// Maps the global semantic id (globalId) to the NYU40, Eigen13 and RIO27 classes.
+// The mapping is the 3RScan class spreadsheet (see data/mapping.txt) exported as
+// csv or tsv: the columns are found by name ("Global ID" and the first column that
+// contains the set name and "ID", or is named like the set).
+class LabelMapping {
+public:
+    const bool Load(const std::string& filename);
+    const bool empty() const { return nyu40_.empty(); }
+    // Dense table indexed by global id, global ids without a class map to 0.
+    const std::vector<uint8_t>& Table(const LabelSet set) const;
+private:
+    std::vector<uint8_t> nyu40_;
+    std::vector<uint8_t> eigen13_;
+    std::vector<uint8_t> rio27_;
+};
+
+// Table lookup for every key: out[stride*i + k] = table[stride*keys[i] + k].
+// Keys that are not in the table map to entry 0. The loop has no data dependent
+// branches so that the compiler can vectorize it, chunks of keys are gathered
+// in parallel (num_threads = 0 uses all hardware threads).
+template<typename Key, typename T>
+void Gather(const std::vector<Key>& keys, const std::vector<T>& table, const size_t stride,
+            T* out, unsigned num_threads = 0) {
+    // Smallest number of keys that is worth a thread of its own.
+    constexpr size_t kMinChunkSize = 1 << 16;
+    const size_t entries = table.size() / stride;
+    if (entries == 0)
+        return;
+    const auto gather = [&](const size_t begin, const size_t end) {
+        const T* entry = table.data();
+        for (size_t i = begin; i < end; i++) {
+            const size_t key = (keys[i] < entries) ? keys[i] : 0;
+            for (size_t k = 0; k < stride; k++)
+                out[stride * i + k] = entry[stride * key + k];
+        }
+    };
+    if (num_threads == 0)
+        num_threads = DefaultThreads();
+    const size_t chunks = std::max<size_t>(1, std::min<size_t>(num_threads, keys.size() / kMinChunkSize));
+    const size_t chunk_size = (keys.size() + chunks - 1) / chunks;
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < chunks; i++)
+        threads.emplace_back(gather, i * chunk_size, std::min(keys.size(), (i + 1) * chunk_size));
+    gather(0, std::min(keys.size(), chunk_size));
+    for (std::thread& thread: threads)
+        thread.join();
+}
+
+}  // namespace RIO
@@ -10,13 +10,20 @@
 #pragma once
 
 #include <Eigen/Dense>
+#include <future>
 #include <opencv2/core/core.hpp>
 #include <string>
+#include <vector>
 
 #include "rio_config.h"
 
 namespace RIO {
 
+// Thread safety: once constructed, one instance can be used by many threads at the
+// same time. All methods are const, the metadata is only written by the constructor,
+// shared caches are locked and decode buffers are per thread (or the PlyWorkspace
+// passed by the caller, which must not be used by two threads at once). Concurrent
+// calls must not write the same output files.
 class RIOLibInterface {
  public:
     virtual ~RIOLibInterface() {}
@@ -27,6 +34,8 @@ class RIOLibInterface {
     // Returns the reference scan id for a rescan id.
     // Returns an empty string if the provided scan id
     virtual const std::string GetReference(const std::string& scan_id) const = 0;
+    // Returns the rescan ids of a reference scan id (empty for rescans).
+    virtual const std::vector<std::string> GetRescans(const std::string& reference_id) const = 0;
     // Saves ply (labels) in ASCII format, retruns true if sucessful.
     virtual const bool ReSavePLYASCII(const std::string& scan_id) const = 0;
     // Aligns the rescans 3D model to the reference
@@ -37,6 +46,9 @@ class RIOLibInterface {
     virtual void PrintSemanticLabels(const std::string& scan_id) const = 0;
     // Aligns an instance with the reference scan given the transformation. 
     virtual const bool TransformInstance(const std::string& scan_id, const int& instance) const = 0;
+    // Aligns all instances of a scan with the reference, reads the scan only once.
+    virtual const bool TransformAllInstances(const std::string& scan_id,
+                                             const InstanceExportOptions& options = InstanceExportOptions()) const = 0;
     // Returns the camera pose of frame_id of a given scan_id. The parameter normalize2reference
     // tells if the pose should be returned in the coordinate system of the reference scan
     // If false, the pose is returned in the original rescan coordinate system. 
@@ -49,10 +61,27 @@ class RIOLibInterface {
     virtual const bool GetCameraPose(Eigen::Matrix4f& pose, const std::string& scan_id, 
                                      const int frame_id, const bool normalize2reference,
                                      const bool mm = false) const = 0;
+    // Returns the camera poses of all frames of a scan in one matrix (frame i is
+    // poses.block<4,4>(0, 4*i)) and the number of frames. Cheaper than calling
+    // GetCameraPose() for every frame.
+    virtual const int GetCameraPoses(const std::string& scan_id, Eigen::Matrix4Xf& poses,
+                                     const bool normalize2reference, const bool mm = false) const = 0;
     // Backprojects the depth image of a given frame_id with the corresponding camera pose
     // Colores point cloud with the corresponding RGB image.
     virtual const bool Backproject(const std::string& scan_id, const int frame_id,
                                    const bool normalized2reference = false) const = 0;
+    // Returns the number of frames of the sequence of a scan (0 if there is none).
+    virtual const int GetNumFrames(const std::string& scan_id) const = 0;
+
+    // Asynchronous versions of the operations above. They return immediately and run
+    // on an internal pool of RIOConfig::async_threads threads, the future holds the
+    // result of the blocking call.
+    virtual std::future<bool> ReSavePLYASCIIAsync(const std::string& scan_id) const = 0;
+    virtual std::future<bool> Transform2ReferenceAsync(const std::string& scan_id) const = 0;
+    virtual std::future<bool> RemapLabelsPlyAsync(const std::string& scan_id) const = 0;
+    virtual std::future<bool> TransformInstanceAsync(const std::string& scan_id, const int instance) const = 0;
+    virtual std::future<bool> BackprojectAsync(const std::string& scan_id, const int frame_id,
+                                               const bool normalized2reference = false) const = 0;
 };
 
 }  // namespace RIO
@@ -0,0 +1,70 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#pragma once
+
+#include <sstream>
+#include <string>
+
+// This header only depends on the standard library since it is shared
+// between rio_lib and rio_renderer.
+
+// Messages below this level are removed at compile time
+// (0: debug, 1: info, 2: warning, 3: error, 4: off).
+#ifndef RIO_LOG_LEVEL
+#define RIO_LOG_LEVEL 0
+#endif
+
+namespace RIO {
+
+enum class LogLevel { Debug = 0, Info = 1, Warning = 2, Error = 3, Off = 4 };
+
+// Runtime verbosity of rio_lib and rio_renderer, messages below it are dropped.
+// The initial level is Info or the value of the environment variable RIO_LOG_LEVEL.
+void SetLogLevel(const LogLevel level);
+const LogLevel GetLogLevel();
+inline const bool LogEnabled(const LogLevel level) {
+    return static_cast<int>(level) >= RIO_LOG_LEVEL && level >= GetLogLevel() && level != LogLevel::Off;
+}
+
+// Hands a message to the log thread. Messages go through a bounded ring buffer and
+// are written by a background thread (debug and info to stdout, warnings and errors
+// to stderr), the streams are only flushed once the buffer runs empty. A full buffer
+// blocks the caller, so messages are never dropped.
+void Log(const LogLevel level, std::string message);
+// Blocks until all queued messages are written. Code that writes to std::cout or
+// std::cerr directly calls it first, otherwise queued messages can end up in the
+// middle of its output.
+void FlushLog();
+
+// Collects one message and logs it when it goes out of scope, see RIO_LOG.
+class LogMessage {
+public:
+    LogMessage(const LogLevel level): level_(level) { }
+    ~LogMessage() { Log(level_, stream_.str()); }
+    std::ostream& stream() { return stream_; }
+private:
+    const LogLevel level_;
+    std::ostringstream stream_;
+};
+
+// Turns the stream expression of RIO_LOG into void, & binds weaker than <<.
+struct LogVoidify {
+    void operator&(std::ostream&) { }
+};
+
+}  // namespace RIO
+
+// Usage: RIO_LOG(Info) << "saved " << filename;
+// Nothing is formatted if the level is disabled. The names are fully qualified
+// since the class RIO::RIO hides the namespace inside of it. The macro is a single
+// expression, so it can be the body of an if without braces.
+#define RIO_LOG(level) \
+    !::RIO::LogEnabled(::RIO::LogLevel::level) ? (void)0 : \
+    ::RIO::LogVoidify() & ::RIO::LogMessage(::RIO::LogLevel::level).stream()
@@ -0,0 +1,85 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// This header only depends on the standard library since it is shared
+// between rio_lib and rio_renderer.
+
+namespace RIO {
+
+// Triangulated obj file (e.g. mesh.refined.v2.obj) stored as structure of arrays.
+struct ObjMesh {
+    std::vector<float> positions;   // x y z
+    std::vector<float> uvs;         // u v
+    std::vector<float> normals;     // x y z
+    // Three 0-based indices per triangle. uv_indices and normal_indices are
+    // empty if the faces do not reference texture coordinates or normals.
+    std::vector<uint32_t> position_indices;
+    std::vector<uint32_t> uv_indices;
+    std::vector<uint32_t> normal_indices;
+    // First mtllib and usemtl statement of the file.
+    std::string material_library{""};
+    std::string material{""};
+
+    const size_t num_positions() const { return positions.size() / 3; }
+    const size_t num_uvs() const { return uvs.size() / 2; }
+    const size_t num_faces() const { return position_indices.size() / 3; }
+    // Empties all arrays but keeps their capacity.
+    void clear();
+};
+
+// Read-only view of a file, memory mapped if possible.
+class MappedFile {
+public:
+    MappedFile(const std::string& filename);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    const bool is_open() const { return open_; }
+    const char* data() const { return data_; }
+    const size_t size() const { return size_; }
+private:
+    const char* data_{nullptr};
+    size_t size_{0};
+    bool open_{false};
+    bool mapped_{false};
+    std::vector<char> buffer_;
+};
+
+// Splits [data, data + size) into at most parts ranges that end at line breaks.
+// Returns parts + 1 offsets.
+std::vector<size_t> SplitLines(const char* data, const size_t size, const unsigned parts);
+
+// Parses v, vt, vn, f, mtllib and usemtl statements of an obj file. The file is
+// memory mapped and split into line chunks that are parsed in parallel;
+// num_threads = 0 uses all hardware threads. Polygons are triangulated as fans.
+// Returns false if the file could not be read.
+const bool LoadObj(const std::string& filename, ObjMesh& mesh, unsigned num_threads = 0);
+
+// Writes the mesh as obj (v, vt, vn and f statements plus the material).
+const bool SaveObj(const std::string& filename, const ObjMesh& mesh);
+// Appends the obj text of the mesh (as written by SaveObj) to out.
+void FormatObj(const ObjMesh& mesh, std::string& out);
+
+// Rewrites all vertex statements of an obj file with the column-major 4x4
+// matrix applied and copies every other line unchanged. The chunks are
+// transformed in parallel and written in order.
+const bool TransformObj(const std::string& input, const std::string& output,
+                        const float* matrix, unsigned num_threads = 0);
+
+// Returns the diffuse texture (map_Kd) of a material library or an empty string.
+const std::string LoadObjTexture(const std::string& mtl_filename);
+
+}  // namespace RIO
@@ -0,0 +1,70 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace RIO {
+
+// Instance of a scan, scan is the position of the scan id in GlobalObjectIndex::scan_ids().
+struct ObjectRef {
+    uint32_t scan;
+    uint32_t instance;
+};
+
+// Objects of one global id or label as [begin, end).
+class ObjectPostings {
+public:
+    ObjectPostings(const ObjectRef* begin = nullptr, const ObjectRef* end = nullptr): begin_(begin), end_(end) { }
+    const ObjectRef* begin() const { return begin_; }
+    const ObjectRef* end() const { return end_; }
+    const size_t size() const { return end_ - begin_; }
+    const bool empty() const { return begin_ == end_; }
+private:
+    const ObjectRef* begin_;
+    const ObjectRef* end_;
+};
+
+// Inverted index of objects.json: for every global id and every label the list of
+// (scan, instance) pairs, ordered by scan id and instance. Both are stored in CSR
+// form (an offset array and one array of all postings), so a query is an array
+// lookup (global id) or a binary search (label) and never touches the scans.
+class GlobalObjectIndex {
+public:
+    void Build(const std::map<std::string, Scan>& scans);
+    // Binary file with the header "rio_object_index 1" followed by the arrays.
+    const bool Save(const std::string& filename) const;
+    const bool Load(const std::string& filename);
+
+    const ObjectPostings Find(const int global_id) const;
+    const ObjectPostings Find(const std::string& label) const;
+    const std::string& scan_id(const ObjectRef& object) const { return scan_ids_[object.scan]; }
+    const std::vector<std::string>& scan_ids() const { return scan_ids_; }
+    // Labels in ascending order.
+    const std::vector<std::string>& labels() const { return labels_; }
+    const size_t num_objects() const { return global_postings_.size(); }
+private:
+    std::vector<std::string> scan_ids_;
+    // global_offsets_[id] is the first posting of global id id (size: max id + 2).
+    std::vector<uint32_t> global_offsets_;
+    std::vector<ObjectRef> global_postings_;
+    std::vector<std::string> labels_;
+    // label_offsets_[i] is the first posting of labels_[i] (size: labels + 1).
+    std::vector<uint32_t> label_offsets_;
+    std::vector<ObjectRef> label_postings_;
+};
+
+}  // namespace RIO
@@ -0,0 +1,78 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "hash.h"
+
+namespace RIO {
+
+// Describes how a derived file (e.g. labels.instances.annotated.v2.align.ply) is
+// computed: the operation and its version, the metadata entries it depends on
+// (e.g. the rescan transformation of 3RScan.json) and its input files.
+class OutputKey {
+public:
+    // Increase the version of an operation whenever its output changes.
+    OutputKey(const std::string& operation, const int version);
+    void AddInput(const std::string& filename);
+    void AddMetadata(const void* data, const size_t size);
+    void AddMetadata(const std::string& value);
+
+    const std::string& operation() const { return operation_; }
+    const std::string& metadata() const { return metadata_; }
+    const std::vector<std::string>& inputs() const { return inputs_; }
+private:
+    // operation and version as written to the key file.
+    std::string operation_;
+    // Hash of all metadata entries.
+    uint64_t metadata_hash_{kHashSeed};
+    std::string metadata_;
+    std::vector<std::string> inputs_;
+};
+
+// The key of an output is stored next to it in <output>.key together with the
+// size, modification time and content hash of every input. An output is up to
+// date if its key file matches: inputs with unchanged size and modification time
+// are accepted without reading them, others only if their content hash is the same.
+// In that case the key file is updated, so the input is not read again next time.
+const bool IsOutputValid(const std::string& output, const OutputKey& key);
+// Writes the key file of an output that was just computed.
+const bool StoreOutputKey(const std::string& output, const OutputKey& key);
+
+// Size and modification time of a file.
+struct FileState {
+    uint64_t size{0};
+    // Modification time in nanoseconds.
+    uint64_t mtime{0};
+};
+// Returns false if the file can not be accessed.
+const bool GetFileState(const std::string& filename, FileState& state);
+
+// Name of a temporary file next to output that is unique to the calling process and
+// thread (<output>.<pid>.<thread id>.tmp).
+const std::string TemporaryFile(const std::string& output);
+
+// Calls write(temporary) and moves the temporary file to output if it succeeded, so
+// that readers never see a partially written output.
+template<typename Write>
+const bool WriteAtomically(const std::string& output, Write write) {
+    const std::string temporary = TemporaryFile(output);
+    if (!write(temporary)) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return std::rename(temporary.c_str(), output.c_str()) == 0;
+}
+
+}  // namespace RIO
@@ -0,0 +1,54 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+#include "types.h"
+
+namespace RIO {
+
+// Owns the ply columns that are parsed for every scan. Passing the same
+// workspace to consecutive RIO calls keeps the capacity of the columns so
+// that a batch run over many scans only allocates when a scan is larger
+// than all previous ones.
+class PlyWorkspace {
+public:
+    // Returns the (emptied) labels ply columns.
+    RIOPlyData& Ply();
+
+    // Number of times Ply() was requested.
+    const size_t uses() const;
+    // Number of column (re-)allocations observed since the workspace was created.
+    const size_t allocations() const;
+    // Number of bytes currently reserved by all columns.
+    const size_t reserved_bytes() const;
+    // Prints the reuse statistics and the peak resident set size of the process.
+    void Report(std::ostream& out) const;
+private:
+    RIOPlyData ply_;
+    size_t uses_{0};
+    size_t allocations_{0};
+    // Capacities of all columns (in elements) as seen on the last request.
+    std::vector<size_t> capacities_;
+    void Track();
+    void Capacities(std::vector<size_t>& capacities) const;
+};
+
+// Workspace of the calling thread, used by the RIO overloads without a workspace
+// so that concurrent calls never share decode buffers.
+PlyWorkspace& ThreadWorkspace();
+
+// Peak resident set size of the current process in bytes (0 if unknown).
+const size_t PeakResidentSetSize();
+
+}  // namespace RIO
@@ -13,9 +13,15 @@
 
 #include "data.h"
 #include "data_config.h"
+#include "geometry_cache.h"
+#include "label_mapping.h"
 #include "lib.h"
+#include "object_index.h"
+#include "output_cache.h"
+#include "ply_workspace.h"
 #include "rio_config.h"
 #include "sequence.h"
+#include "thread_pool.h"
 #include "types.h"
 
 namespace RIO {
@@ -36,15 +42,33 @@ public:
     const bool IsRescan(const std::string& scan_id) const override;
     // Returns true if the given scan_id is a reference.
     const bool IsReference(const std::string& scan_id) const override;
+    // Returns true if 3RScan.json lists the scan as a reference or a rescan.
+    const bool HasScan(const std::string& scan_id) const;
+    // Get the rescan ids of the given reference.
+    const std::vector<std::string> GetRescans(const std::string& reference_id) const override;
+    // Get the transformation of a rescan to its reference (identity for references).
+    const Eigen::Matrix4f GetRescanTransform(const std::string& scan_id) const;
     // re-save binary encoded labels.instances.annotated.ply as ASCII file
     // this creates a labels.instances.annotated.ascii.ply in data_path/scan_id
     const bool ReSavePLYASCII(const std::string& scan_id) const override;
+    const bool ReSavePLYASCII(const std::string& scan_id, PlyWorkspace& workspace) const;
     // aligns labels.instances.annotated.ply and mesh.refined.obj of a rescan
     // to the reference and creates labels.instances.annotated.align.ply and
     // mesh.refined.align.obj in data_path/scan_id
     const bool Transform2Reference(const std::string& scan_id) const override;
+    const bool Transform2Reference(const std::string& scan_id, PlyWorkspace& workspace) const;
     // saves ply with remaped local instance id "objectId" to global ID globalId.
     const bool RemapLabelsPly(const std::string& scan_id) const override;
+    const bool RemapLabelsPly(const std::string& scan_id, PlyWorkspace& workspace) const;
+    // Key of the output of RemapLabelsPly (see rio_lib/output_cache.h), its metadata
+    // covers the instances of objects.json and the colors of the global ids.
+    const OutputKey RemapLabelsKey(const std::string& scan_id) const;
+    // saves ply with the instances remapped to the classes of a label set (NYU40, Eigen13
+    // or RIO27), e.g. labels.instances.annotated.v2.nyu40.ply. Requires the class mapping
+    // (DataConfig::GetMapping).
+    const bool RemapLabelsPly(const std::string& scan_id, const LabelSet set) const;
+    const bool RemapLabelsPly(const std::string& scan_id, const LabelSet set,
+                              PlyWorkspace& workspace) const;
     // Returns the camera pose of frame_id of a given scan_id. The parameter normalize2reference
     // tells if the pose should be returned in the coordinate system of the reference scan
     // If false, the pose is returned in the original rescan coordinate system. 
@@ -64,14 +88,50 @@ public:
     // Colores point cloud with the corresponding RGB image.
     const bool Backproject(const std::string& scan_id, const int frame_id, 
                            const bool normalized2reference = false) const override;
+    // Returns the number of frames of the sequence of a scan (0 if there is none).
+    const int GetNumFrames(const std::string& scan_id) const override;
+    // Returns the camera poses of all frames in one matrix, frame i is poses.block<4,4>(0, 4*i).
+    const int GetCameraPoses(const std::string& scan_id, Eigen::Matrix4Xf& poses,
+                             const bool normalize2reference, const bool mm = false) const override;
     // Prints a list of all the semantic labels of the scan.
     void PrintSemanticLabels(const std::string& scan_id) const override;
     const bool TransformInstance(const std::string& scan_id, const int& instance) const override;
+    const bool TransformInstance(const std::string& scan_id, const int& instance,
+                                 PlyWorkspace& workspace) const;
+    // Exports every instance of the scan like TransformInstance() but parses the ply and obj
+    // only once. The meshes are extracted, transformed and written by options.num_threads
+    // threads, either as mesh.refined.v2.align.instance.<id>.obj files or as one archive
+    // (DataConfig::GetInstanceArchive) with a header that lists the offset and size of
+    // every instance.
+    const bool TransformAllInstances(const std::string& scan_id,
+                                     const InstanceExportOptions& options = InstanceExportOptions()) const override;
+    const bool TransformAllInstances(const std::string& scan_id, const InstanceExportOptions& options,
+                                     PlyWorkspace& workspace) const;
+    // The overloads with a PlyWorkspace parse into the columns of the workspace instead
+    // of a temporary RIOPlyData. Reuse one workspace per thread when processing many scans.
+
+    // The labels ply of scans that are used repeatedly stays parsed in a cache (with the
+    // memory budget RIOConfig::geometry_cache_bytes), a scan that is used once is parsed
+    // straight into the workspace. Operations that change a cached geometry work on a copy
+    // in the workspace. Schedulers can load a scan ahead of time or release it early.
+    void Preload(const std::string& scan_id) const;
+    void Evict(const std::string& scan_id) const;
+    const GeometryCache& geometry_cache() const { return geometry_cache_; }
+    // Scans and instances of every global id and label of objects.json.
+    const GlobalObjectIndex& object_index() const { return object_index_; }
+
+    std::future<bool> ReSavePLYASCIIAsync(const std::string& scan_id) const override;
+    std::future<bool> Transform2ReferenceAsync(const std::string& scan_id) const override;
+    std::future<bool> RemapLabelsPlyAsync(const std::string& scan_id) const override;
+    std::future<bool> TransformInstanceAsync(const std::string& scan_id, const int instance) const override;
+    std::future<bool> BackprojectAsync(const std::string& scan_id, const int frame_id,
+                                       const bool normalized2reference = false) const override;
 private:
     const bool LoadObjects(const std::string& objects);
     bool TransformPly2Reference(const std::string& scan_id,
                                 const std::string& filename_in,
-                                const std::string& filename_out) const;
+                                const std::string& filename_out,
+                                PlyWorkspace& workspace) const;
     bool TransformObj2Reference(const std::string& scan_id,
                                 const std::string& filename_in,
                                 const std::string& filename_out) const;
@@ -81,12 +141,33 @@ private:
     std::map<std::string, Scan> scans;
     
     void InitGlobalId2Color(const int size);
-    std::vector<Eigen::Vector3i, Eigen::aligned_allocator<Eigen::Vector3i>> globalId2color;
+    // r g b of every global id.
+    std::vector<uint8_t> globalId2rgb;
+    LabelMapping label_mapping_;
+    GlobalObjectIndex object_index_;
+    mutable GeometryCache geometry_cache_;
+    // Returns the ply from the geometry cache if it is cached or used repeatedly, failed
+    // is set if it had to be loaded and has no vertices.
+    std::shared_ptr<const RIOPlyData> CachedPly(const std::string& filename, bool& failed) const;
+    // Returns a parsed ply for reading, cached is set if it comes from the cache. Returns
+    // nullptr if the file has no vertices.
+    const RIOPlyData* ReadPly(const std::string& filename, PlyWorkspace& workspace,
+                              std::shared_ptr<const RIOPlyData>& cached) const;
+    // Returns a parsed ply in the workspace that may be changed, nullptr if the file has
+    // no vertices.
+    RIOPlyData* CopyPly(const std::string& filename, PlyWorkspace& workspace) const;
 
     const RIOConfig config_;
     const DataConfig data_config_;
     Data json_data_;
     const Sequence sequence_;
+
+    // Runs the *Async operations, created on first use. Declared last so that it
+    // finishes all queued operations before the other members are destroyed.
+    mutable std::once_flag executor_once_;
+    mutable std::unique_ptr<ThreadPool> executor_;
+    template<typename Operation>
+    std::future<bool> Async(Operation operation) const;
 };
 
 }  // namespace RIO
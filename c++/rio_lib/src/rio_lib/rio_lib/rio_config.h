@@ -9,13 +9,32 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 namespace RIO {
 
+// Options for RIO::TransformAllInstances().
+struct InstanceExportOptions {
+    // Writes all instances into one indexed archive instead of one obj file per instance.
+    bool single_archive{false};
+    // Number of threads that extract and write instances (0 uses all hardware threads).
+    unsigned num_threads{0};
+};
+
 struct RIOConfig {
     const std::string data_path{""};
-    RIOConfig(const RIOConfig& config): data_path(config.data_path) { }
+    // Skips Transform2Reference and RemapLabelsPly if their outputs are up to date
+    // (see rio_lib/output_cache.h).
+    bool cache_outputs{true};
+    // Memory budget of the parsed labels ply files that RIO keeps between calls (0 disables it).
+    size_t geometry_cache_bytes{512 * 1024 * 1024};
+    // Number of threads that run the *Async operations (0 uses all hardware threads). Each
+    // operation on the executor loads and gathers on its worker thread only.
+    unsigned async_threads{0};
+    RIOConfig(const RIOConfig& config): data_path(config.data_path), cache_outputs(config.cache_outputs),
+                                        geometry_cache_bytes(config.geometry_cache_bytes),
+                                        async_threads(config.async_threads) { }
     RIOConfig(const std::string data_path): data_path(data_path) { }
 };
 
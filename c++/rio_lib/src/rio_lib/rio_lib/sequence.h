@@ -26,8 +26,16 @@ public:
                                   const int& frame_id,
                                   const bool normalized2reference,
                                   const bool mm, bool& valid_pose) const;
+    // Loads the poses of all frames (until the first missing pose file) into one matrix,
+    // frame i is poses.block<4,4>(0, 4*i). The pose files are read in parallel and
+    // aligned to the reference with a single product. Returns the number of frames.
+    const int GetPoses(const std::string& scan_id, const bool normalized2reference,
+                       const bool mm, Eigen::Matrix4Xf& poses) const;
     const bool Backproject(const std::string& scan_id, const int frame_id, 
                            const bool normalized2reference = false) const;
+    // Number of frames of the sequence (m_frames.size in _info.txt), if the info file has
+    // no frame count the pose files are counted.
+    const int GetNumFrames(const std::string& scan_id) const;
 private:
     const Data& json_data_;
     const FrameConfig config_;
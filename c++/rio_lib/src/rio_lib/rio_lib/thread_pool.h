@@ -0,0 +1,76 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RIO {
+
+// Number of worker threads to use if 0 is requested (all hardware threads).
+const unsigned DefaultThreads();
+
+// Work-stealing thread pool. Every worker owns a task queue; once its queue is
+// empty, it steals the oldest task of another worker. Tasks submitted from
+// outside the pool are spread over the queues and run in submission order.
+// Tasks submitted by a worker go to its own queue and run newest first, so a
+// task that splits its work (e.g. a scan into frame ranges) keeps it local
+// unless other workers are idle.
+class ThreadPool {
+public:
+    // num_threads = 0 uses all hardware threads.
+    ThreadPool(unsigned num_threads = 0);
+    // Waits for all tasks and stops the workers.
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Submit(std::function<void()> task);
+    // Blocks until all submitted tasks (including the ones they submit) have finished.
+    // Must not be called from a worker.
+    void Wait();
+
+    const unsigned num_threads() const { return static_cast<unsigned>(threads_.size()); }
+    // Index of the calling worker in [0, num_threads()), -1 if called from outside the pool.
+    const int worker() const;
+    // Number of tasks that were stolen from the queue of another worker.
+    const size_t steals() const { return steals_; }
+private:
+    struct Queue {
+        std::mutex mutex;
+        // Tasks submitted from outside the pool (FIFO) and by the owning worker (LIFO).
+        std::deque<std::function<void()>> tasks;
+        std::deque<std::function<void()>> spawned;
+    };
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    // Protects queued_, pending_ and stop_.
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    // Tasks in the queues and tasks that were submitted but did not finish yet.
+    size_t queued_{0};
+    size_t pending_{0};
+    bool stop_{false};
+    std::atomic<size_t> next_queue_{0};
+    std::atomic<size_t> steals_{0};
+
+    void Run(const unsigned index);
+    const bool Pop(const unsigned index, std::function<void()>& task);
+};
+
+}  // namespace RIO
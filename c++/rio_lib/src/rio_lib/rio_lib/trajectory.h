@@ -0,0 +1,41 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#pragma once
+
+#include <string>
+#include <Eigen/Dense>
+
+namespace RIO {
+
+// Output of the aligned camera poses of a sequence. Frames writes one
+// frame-xxxxxx.align.pose.txt per frame (as the sequence stores its poses), Text
+// and Binary write the whole trajectory into one file.
+enum class TrajectoryFormat { Frames, Text, Binary };
+
+const std::string TrajectoryFormatName(const TrajectoryFormat format);
+// Parses "frames", "text" or "binary", returns false if unknown.
+const bool ParseTrajectoryFormat(const std::string& name, TrajectoryFormat& format);
+// Name of the trajectory file in the output folder (empty for Frames).
+const std::string TrajectoryFilename(const TrajectoryFormat format);
+
+// Writes the poses of frames [begin, end) as 4x4 text matrices, one file
+// folder/<prefix>xxxxxx.align.pose.txt per frame. Frame i is the block
+// poses.block<4,4>(0, 4*i). Returns false if a file could not be written.
+const bool SavePoses(const std::string& folder, const std::string& prefix,
+                     const Eigen::Matrix4Xf& poses, const int begin, const int end);
+
+// Writes all poses into one file. Text has one line per frame with the frame id and
+// the 16 values of the matrix (row-major). Binary starts with the text header
+// "rio_trajectory 1", "frames N", "end_header" followed by N row-major 4x4 float32
+// matrices.
+const bool SaveTrajectory(const std::string& filename, const Eigen::Matrix4Xf& poses,
+                          const TrajectoryFormat format);
+
+}  // namespace RIO
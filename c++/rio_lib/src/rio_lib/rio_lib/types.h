@@ -21,6 +21,8 @@ public:
     std::map<int, std::string> instance2labels;
     // Maps the instance Id of the current scene to the global semantic identifier.
     std::map<int, int> instance2global;
+    // Dense version of instance2global indexed by the instance Id (unknown instances map to 0).
+    std::vector<uint16_t> instance2global_table;
 };
 
 enum class CalibFormat { InfoTxt, YAML };
@@ -48,8 +50,12 @@ struct RIOPlyData {
     std::vector<uint8_t> Eigen13;
     std::vector<uint8_t> RIO27;
 
-    const bool save(const std::string& filename, const bool ascii);
+    const bool save(const std::string& filename, const bool ascii) const;
     const uint32_t load(const std::string filename);
+    // Empties all columns but keeps their capacity, load() calls this before parsing.
+    void clear();
+    // Number of bytes currently reserved by all columns.
+    const size_t capacity_bytes() const;
 };
 
 struct Intrinsics {
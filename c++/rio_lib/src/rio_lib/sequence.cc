@@ -1,9 +1,13 @@
 #include "rio_lib/sequence.h"
 
+#include <algorithm>
 #include <fstream>
+#include <thread>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "rio_lib/log.h"
+#include "rio_lib/thread_pool.h"
 #include "rio_lib/utils.h"
 #include "rio_lib/types.h"
 
@@ -27,6 +31,40 @@ const Eigen::Matrix4f Sequence::GetPose(const std::string& scan_id,
          return pose;
 }
 
+const int Sequence::GetPoses(const std::string& scan_id, const bool normalized2reference,
+                             const bool mm, Eigen::Matrix4Xf& poses) const {
+    const int frames = GetNumFrames(scan_id);
+    poses.resize(4, 4 * frames);
+    std::vector<char> valid(frames, 0);
+    const auto load = [&](const int begin, const int end) {
+        Eigen::Matrix4f pose;
+        for (int frame_id = begin; frame_id < end; frame_id++) {
+            valid[frame_id] = LoadPose(config_.GetPose(scan_id, frame_id), pose, mm);
+            poses.block<4,4>(0, 4 * frame_id) = pose;
+        }
+    };
+    // Small files, so each thread gets at least 64 of them.
+    const int num_threads = std::max(1, std::min(static_cast<int>(RIO::DefaultThreads()), frames / 64));
+    const int chunk = (frames + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+    for (int begin = chunk; begin < frames; begin += chunk)
+        threads.emplace_back(load, begin, std::min(frames, begin + chunk));
+    load(0, std::min(frames, chunk));
+    for (std::thread& thread: threads)
+        thread.join();
+    // Like reading the poses one by one, the sequence ends at the first missing pose.
+    const int loaded = static_cast<int>(std::find(valid.begin(), valid.end(), 0) - valid.begin());
+    poses.conservativeResize(4, 4 * loaded);
+    if (normalized2reference && loaded > 0) {
+        Eigen::Matrix4f rescan2reference{json_data_.GetRescanTransform(scan_id)};
+        if (mm)
+            rescan2reference.block<3,1>(0,3) *= kMeterToMillimeter;
+        // rescan2reference * [P_0 ... P_n] aligns all frames at once.
+        poses = rescan2reference * poses;
+    }
+    return loaded;
+}
+
 bool Sequence::LoadPose(const std::string& pose_file, Eigen::Matrix4f& pose,
                         const bool transform_mm) const {
     bool valid_pose = false;
@@ -44,6 +82,20 @@ bool Sequence::LoadPose(const std::string& pose_file, Eigen::Matrix4f& pose,
     return valid_pose;
 }
 
+const int Sequence::GetNumFrames(const std::string& scan_id) const {
+    const std::string search_tag = "m_frames.size";
+    std::string line{""};
+    std::ifstream file(config_.GetCameraInfo(scan_id));
+    while (file.is_open() && std::getline(file, line)) {
+        if (line.rfind(search_tag, 0) == 0)
+            return std::stoi(line.substr(line.find("= ")+2, std::string::npos));
+    }
+    int frames = 0;
+    while (std::ifstream(config_.GetPose(scan_id, frames)).is_open())
+        frames++;
+    return frames;
+}
+
 bool Sequence::LoadInfoIntrinsics(const std::string& filename,
                                   const bool depth_intrinsics,
                                   RIO::Intrinsics& intrinsics) const {
@@ -116,12 +168,11 @@ bool Sequence::LoadIntrinsics(const RIO::CalibFormat& format,
 
 const bool Sequence::Backproject(const std::string& scan_id, const int frame_id,
                                  const bool normalized2reference) const {
-    std::cout << normalized2reference << std::endl;
     // The depth stores the distance in mm as a 16bit.
     cv::Mat RGB_resized;
     cv::Mat depth = cv::imread(config_.GetDepth(scan_id, frame_id), -1);
     if (depth.empty()) {
-        std::cout << "file not found." << config_.GetDepth(scan_id, frame_id) << std::endl;
+        RIO_LOG(Warning) << "file not found: " << config_.GetDepth(scan_id, frame_id);
         return false;
     }
     cv::Mat RGB = cv::imread(config_.GetColor(scan_id, frame_id), -1);
@@ -109,18 +109,19 @@ void PlyFile::read_header_property(std::istream & is)
 
 size_t PlyFile::skip_property_binary(const PlyProperty & property, std::istream & is)
 {
-    static std::vector<char> skip(PropertyTable[property.propertyType].stride);
+    // Stack scratch instead of a function static, so that files can be read concurrently.
+    char skip[8];
     if (property.isList)
     {
 		size_t listSize = 0;
 		size_t dummyCount = 0;
         read_property_binary(property.listType, &listSize, dummyCount, is);
-        for (size_t i = 0; i < listSize; ++i) is.read(skip.data(), PropertyTable[property.propertyType].stride);
+        for (size_t i = 0; i < listSize; ++i) is.read(skip, PropertyTable.at(property.propertyType).stride);
         return listSize;
     }
     else
     {
-        is.read(skip.data(), PropertyTable[property.propertyType].stride);
+        is.read(skip, PropertyTable.at(property.propertyType).stride);
         return 0;
     }
 }
@@ -139,22 +140,23 @@ void PlyFile::skip_property_ascii(const PlyProperty & property, std::istream & i
 
 void PlyFile::read_property_binary(PlyProperty::Type t, void * dest, size_t & destOffset, std::istream & is)
 {
-    static std::vector<char> src(PropertyTable[t].stride);
-    is.read(src.data(), PropertyTable[t].stride);
+    // Large enough for the widest type (double), see skip_property_binary.
+    alignas(8) char src[8];
+    is.read(src, PropertyTable.at(t).stride);
 
     switch (t)
     {
-        case PlyProperty::Type::INT8:       ply_cast<int8_t>(dest, src.data(), isBigEndian);        break;
-        case PlyProperty::Type::UINT8:      ply_cast<uint8_t>(dest, src.data(), isBigEndian);       break;
-        case PlyProperty::Type::INT16:      ply_cast<int16_t>(dest, src.data(), isBigEndian);       break;
-        case PlyProperty::Type::UINT16:     ply_cast<uint16_t>(dest, src.data(), isBigEndian);      break;
-        case PlyProperty::Type::INT32:      ply_cast<int32_t>(dest, src.data(), isBigEndian);       break;
-        case PlyProperty::Type::UINT32:     ply_cast<uint32_t>(dest, src.data(), isBigEndian);      break;
-        case PlyProperty::Type::FLOAT32:    ply_cast_float<float>(dest, src.data(), isBigEndian);   break;
-        case PlyProperty::Type::FLOAT64:    ply_cast_double<double>(dest, src.data(), isBigEndian); break;
+        case PlyProperty::Type::INT8:       ply_cast<int8_t>(dest, src, isBigEndian);        break;
+        case PlyProperty::Type::UINT8:      ply_cast<uint8_t>(dest, src, isBigEndian);       break;
+        case PlyProperty::Type::INT16:      ply_cast<int16_t>(dest, src, isBigEndian);       break;
+        case PlyProperty::Type::UINT16:     ply_cast<uint16_t>(dest, src, isBigEndian);      break;
+        case PlyProperty::Type::INT32:      ply_cast<int32_t>(dest, src, isBigEndian);       break;
+        case PlyProperty::Type::UINT32:     ply_cast<uint32_t>(dest, src, isBigEndian);      break;
+        case PlyProperty::Type::FLOAT32:    ply_cast_float<float>(dest, src, isBigEndian);   break;
+        case PlyProperty::Type::FLOAT64:    ply_cast_double<double>(dest, src, isBigEndian); break;
         case PlyProperty::Type::INVALID:    throw std::invalid_argument("invalid ply property");
     }
-    destOffset += PropertyTable[t].stride;
+    destOffset += PropertyTable.at(t).stride;
 }
 
 void PlyFile::read_property_ascii(PlyProperty::Type t, void * dest, size_t & destOffset, std::istream & is)
@@ -171,7 +173,7 @@ void PlyFile::read_property_ascii(PlyProperty::Type t, void * dest, size_t & des
         case PlyProperty::Type::FLOAT64:    ply_cast_ascii<double>(dest, is);                       break;
         case PlyProperty::Type::INVALID:    throw std::invalid_argument("invalid ply property");
     }
-    destOffset += PropertyTable[t].stride;
+    destOffset += PropertyTable.at(t).stride;
 }
 
 void PlyFile::write_property_ascii(PlyProperty::Type t, std::ostream & os, uint8_t * src, size_t & srcOffset)
@@ -189,13 +191,13 @@ void PlyFile::write_property_ascii(PlyProperty::Type t, std::ostream & os, uint8
         case PlyProperty::Type::INVALID:    throw std::invalid_argument("invalid ply property");
     }
     os << " ";
-    srcOffset += PropertyTable[t].stride;
+    srcOffset += PropertyTable.at(t).stride;
 }
 
 void PlyFile::write_property_binary(PlyProperty::Type t, std::ostream & os, uint8_t * src, size_t & srcOffset)
 {
-    os.write((char *)src, PropertyTable[t].stride);
-    srcOffset += PropertyTable[t].stride;
+    os.write((char *)src, PropertyTable.at(t).stride);
+    srcOffset += PropertyTable.at(t).stride;
 }
 
 void PlyFile::read(std::istream & is)
@@ -291,12 +293,12 @@ void PlyFile::write_header(std::ostream & os)
         {
             if (p.isList)
             {
-                os << "property list " << PropertyTable[p.listType].str << " "
-                << PropertyTable[p.propertyType].str << " " << p.name << "\n";
+                os << "property list " << PropertyTable.at(p.listType).str << " "
+                << PropertyTable.at(p.propertyType).str << " " << p.name << "\n";
             }
             else
             {
-                os << "property " << PropertyTable[p.propertyType].str << " " << p.name << "\n";
+                os << "property " << PropertyTable.at(p.propertyType).str << " " << p.name << "\n";
             }
         }
     }
@@ -116,7 +116,7 @@ namespace tinyply
 	}
 
 	struct PropertyInfo { int stride; std::string str; };
-	static std::map<PlyProperty::Type, PropertyInfo> PropertyTable
+	static const std::map<PlyProperty::Type, PropertyInfo> PropertyTable
 	{
 		{ PlyProperty::Type::INT8,{ 1, "char" } },
 		{ PlyProperty::Type::UINT8,{ 1, "uchar" } },
@@ -242,7 +242,7 @@ namespace tinyply
 					{
 						if (p.name == propertyKey)
 						{
-							if (PropertyTable[property_type_for_type(source)].stride != PropertyTable[p.propertyType].stride)
+							if (PropertyTable.at(property_type_for_type(source)).stride != PropertyTable.at(p.propertyType).stride)
 								throw std::runtime_error("destination vector is wrongly typed to hold this property");
 							return e.size;
 
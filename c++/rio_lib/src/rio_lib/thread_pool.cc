@@ -0,0 +1,120 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#include "rio_lib/thread_pool.h"
+
+#include <algorithm>
+
+namespace RIO {
+
+namespace {
+
+// Pool and index of the worker that runs on the current thread.
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local int current_worker = -1;
+
+}  // namespace
+
+const unsigned DefaultThreads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+ThreadPool::ThreadPool(unsigned num_threads) {
+    if (num_threads == 0)
+        num_threads = DefaultThreads();
+    for (unsigned i = 0; i < num_threads; i++)
+        queues_.emplace_back(new Queue());
+    for (unsigned i = 0; i < num_threads; i++)
+        threads_.emplace_back(&ThreadPool::Run, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    Wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread: threads_)
+        thread.join();
+}
+
+const int ThreadPool::worker() const {
+    return (current_pool == this) ? current_worker : -1;
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    // Count the task before it becomes visible, so that the counters never underflow.
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_++;
+        pending_++;
+    }
+    const int own = worker();
+    Queue& queue = *queues_[(own >= 0) ? own : next_queue_++ % queues_.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        ((own >= 0) ? queue.spawned : queue.tasks).push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+void ThreadPool::Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return pending_ == 0; });
+}
+
+const bool ThreadPool::Pop(const unsigned index, std::function<void()>& task) {
+    // Own queue first (newest spawned task, then oldest submitted task), then the
+    // other queues (oldest task).
+    for (size_t i = 0; i < queues_.size(); i++) {
+        Queue& queue = *queues_[(index + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (i == 0 && !queue.spawned.empty()) {
+            task = std::move(queue.spawned.back());
+            queue.spawned.pop_back();
+            return true;
+        }
+        std::deque<std::function<void()>>& tasks = queue.spawned.empty() ? queue.tasks : queue.spawned;
+        if (tasks.empty())
+            continue;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+        if (i != 0)
+            steals_++;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::Run(const unsigned index) {
+    current_pool = this;
+    current_worker = static_cast<int>(index);
+    std::function<void()> task;
+    while (true) {
+        if (Pop(index, task)) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                queued_--;
+            }
+            task();
+            task = nullptr;
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_ == 0)
+                done_.notify_all();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+        if (stop_ && queued_ == 0)
+            return;
+    }
+}
+
+}  // namespace RIO
@@ -0,0 +1,94 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#include "rio_lib/trajectory.h"
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "rio_lib/output_cache.h"
+
+namespace RIO {
+
+const std::string TrajectoryFormatName(const TrajectoryFormat format) {
+    switch (format) {
+        case TrajectoryFormat::Frames: return "frames";
+        case TrajectoryFormat::Text: return "text";
+        case TrajectoryFormat::Binary: return "binary";
+    }
+    return "";
+}
+
+const bool ParseTrajectoryFormat(const std::string& name, TrajectoryFormat& format) {
+    for (const TrajectoryFormat candidate: { TrajectoryFormat::Frames, TrajectoryFormat::Text,
+                                             TrajectoryFormat::Binary }) {
+        if (TrajectoryFormatName(candidate) == name) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::string TrajectoryFilename(const TrajectoryFormat format) {
+    switch (format) {
+        case TrajectoryFormat::Text: return "trajectory.align.txt";
+        case TrajectoryFormat::Binary: return "trajectory.align.bin";
+        default: return "";
+    }
+}
+
+const bool SavePoses(const std::string& folder, const std::string& prefix,
+                     const Eigen::Matrix4Xf& poses, const int begin, const int end) {
+    bool success = true;
+    std::stringstream filename;
+    for (int frame_id = begin; frame_id < end; frame_id++) {
+        filename.str("");
+        filename << folder << "/" << prefix << std::setfill('0') << std::setw(6) << frame_id
+                 << ".align.pose.txt";
+        // Printed as a fixed size matrix so that the files match the ones of GetCameraPose().
+        const Eigen::Matrix4f pose = poses.block<4,4>(0, 4 * frame_id);
+        std::ofstream file(filename.str());
+        file << pose;
+        success &= file.good();
+    }
+    return success;
+}
+
+const bool SaveTrajectory(const std::string& filename, const Eigen::Matrix4Xf& poses,
+                          const TrajectoryFormat format) {
+    const int frames = static_cast<int>(poses.cols() / 4);
+    return WriteAtomically(filename, [&](const std::string& temporary) {
+        std::ofstream file(temporary, std::ios::binary);
+        if (format == TrajectoryFormat::Binary) {
+            file << "rio_trajectory 1\n" << "frames " << frames << "\n" << "end_header\n";
+            // The matrix is column-major, one transpose turns every block row-major.
+            std::vector<float> values(16 * static_cast<size_t>(frames));
+            for (int i = 0; i < frames; i++) {
+                Eigen::Map<Eigen::Matrix4f> block(&values[16 * i]);
+                block = poses.block<4,4>(0, 4 * i).transpose();
+            }
+            file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+        } else {
+            file << std::setprecision(9);
+            for (int i = 0; i < frames; i++) {
+                file << i;
+                for (int row = 0; row < 4; row++)
+                    for (int col = 0; col < 4; col++)
+                        file << " " << poses(row, 4 * i + col);
+                file << "\n";
+            }
+        }
+        return file.good();
+    });
+}
+
+}  // namespace RIO
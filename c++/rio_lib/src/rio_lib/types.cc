@@ -9,6 +9,7 @@
 
 #include "rio_lib/types.h"
 
+#include "rio_lib/log.h"
 #include "third_party/tinyply.h"
 
 #include <fstream>
@@ -24,37 +25,65 @@ const bool PlyData::save(const std::string& filename, const bool ascii) {
     out_file.add_properties_to_element("vertex", { "red", "green", "blue" }, colors);
     out_file.write(ss, !ascii);
     fb.close();
-    std::cout << "saved as " << filename << std::endl;
+    RIO_LOG(Debug) << "saved as " << filename;
     return true;
 }
 
-const bool RIOPlyData::save(const std::string& filename, const bool ascii) {
+const bool RIOPlyData::save(const std::string& filename, const bool ascii) const {
+    // tinyply takes non-const columns but only reads them when writing.
+    RIOPlyData& ply = const_cast<RIOPlyData&>(*this);
     std::filebuf fb;
-    fb.open(filename, v2 ? std::ios::out : (std::ios::out | std::ios::binary));
+    if (!fb.open(filename, v2 ? std::ios::out : (std::ios::out | std::ios::binary)))
+        return false;
     std::ostream ss(&fb);
     tinyply::PlyFile out_file;
-    out_file.add_properties_to_element("vertex", { "x", "y", "z" }, vertices);
-    out_file.add_properties_to_element("vertex", { "red", "green", "blue" }, colors);
-    out_file.add_properties_to_element("vertex", { "objectId" }, object_ids);
-    if (!global_ids.empty())
-        out_file.add_properties_to_element("vertex", { "globalId" }, global_ids);    
+    out_file.add_properties_to_element("vertex", { "x", "y", "z" }, ply.vertices);
+    out_file.add_properties_to_element("vertex", { "red", "green", "blue" }, ply.colors);
+    out_file.add_properties_to_element("vertex", { "objectId" }, ply.object_ids);
+    if (!ply.global_ids.empty())
+        out_file.add_properties_to_element("vertex", { "globalId" }, ply.global_ids);    
     if (v2) {
-        out_file.add_properties_to_element("vertex", { "NYU40" }, NYU40);
-        out_file.add_properties_to_element("vertex", { "Eigen13" }, Eigen13);
-        out_file.add_properties_to_element("vertex", { "RIO27" }, RIO27);
+        out_file.add_properties_to_element("vertex", { "NYU40" }, ply.NYU40);
+        out_file.add_properties_to_element("vertex", { "Eigen13" }, ply.Eigen13);
+        out_file.add_properties_to_element("vertex", { "RIO27" }, ply.RIO27);
     } else {  
-        out_file.add_properties_to_element("vertex", { "categoryId" }, category_ids);
-        out_file.add_properties_to_element("vertex", { "NYU40" }, raw_nyu40);
-        out_file.add_properties_to_element("vertex", { "mpr40" }, raw_mpr40);
+        out_file.add_properties_to_element("vertex", { "categoryId" }, ply.category_ids);
+        out_file.add_properties_to_element("vertex", { "NYU40" }, ply.raw_nyu40);
+        out_file.add_properties_to_element("vertex", { "mpr40" }, ply.raw_mpr40);
     }
-    out_file.add_properties_to_element("face", { "vertex_indices" }, faces, 3, tinyply::PlyProperty::Type::UINT8);
+    out_file.add_properties_to_element("face", { "vertex_indices" }, ply.faces, 3, tinyply::PlyProperty::Type::UINT8);
     out_file.write(ss, !ascii);
-    fb.close();
-    std::cout << "saved as " << filename << std::endl;
-    return true;
+    const bool success = ss.good() && fb.close();
+    RIO_LOG(Debug) << "saved as " << filename;
+    return success;
+}
+
+void RIOPlyData::clear() {
+    vertices.clear();
+    colors.clear();
+    faces.clear();
+    global_ids.clear();
+    object_ids.clear();
+    category_ids.clear();
+    raw_nyu40.clear();
+    raw_mpr40.clear();
+    NYU40.clear();
+    Eigen13.clear();
+    RIO27.clear();
+}
+
+const size_t RIOPlyData::capacity_bytes() const {
+    return vertices.capacity() * sizeof(float) +
+           faces.capacity() * sizeof(uint32_t) +
+           (global_ids.capacity() + object_ids.capacity() + category_ids.capacity()) * sizeof(uint16_t) +
+           colors.capacity() + raw_nyu40.capacity() + raw_mpr40.capacity() +
+           NYU40.capacity() + Eigen13.capacity() + RIO27.capacity();
 }
 
 const uint32_t RIOPlyData::load(const std::string filename) {
+    // Columns that are not part of the file are not touched by tinyply,
+    // so make sure nothing from a previous load survives.
+    clear();
     std::ifstream ss(filename, v2 ? std::ios::in : std::ios::binary);
     tinyply::PlyFile input_file(ss);
     input_file.request_properties_from_element("vertex", { "x", "y", "z" }, vertices);
@@ -0,0 +1,313 @@
+/*******************************************************
+ * Copyright (c) 2020, Johanna Wald
+ * All rights reserved.
+ *
+ * This file is distributed under the GNU Lesser General Public License v3.0.
+ * The complete license agreement can be obtained at:
+ * http://www.gnu.org/licenses/lgpl-3.0.html
+ ********************************************************/
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+#include <opencv2/highgui/highgui.hpp>
+#include <rio_lib/data_config.h>
+#include <rio_lib/frame_config.h>
+#include <rio_lib/log.h>
+#include <rio_lib/rio_config.h>
+#include <rio_lib/rio.h>
+#include <rio_lib/types.h>
+
+namespace {
+
+constexpr int kInstances = 20;
+constexpr int kOperations = 8;
+constexpr int kFrames = 4;
+constexpr int kFrameWidth = 32;
+constexpr int kFrameHeight = 24;
+constexpr RIO::LabelSet kLabelSets[] = { RIO::LabelSet::NYU40, RIO::LabelSet::Eigen13, RIO::LabelSet::RIO27 };
+
+// How a round runs the operations, the serial run uses Sync.
+enum class Variant {
+    Sync,
+    // The *Async operations, waiting for their futures.
+    Async,
+    // Like Sync, but the instances are written by TransformAllInstances.
+    AllInstances
+};
+const char* const kVariantNames[] = { "sync", "async", "all instances" };
+
+const std::string ScanId(const int scan) {
+    return "scan_" + std::to_string(scan);
+}
+
+// Writes the camera info, poses and depth and color images of kFrames frames.
+const bool WriteSyntheticFrames(const FrameConfig& frame_config, const std::string& scan_id, const int scan) {
+    mkdir((frame_config.base_path + "/" + scan_id + "/" + frame_config.sequence_folder).c_str(), 0755);
+    std::ofstream info(frame_config.GetCameraInfo(scan_id));
+    info << "m_depthWidth = " << kFrameWidth << "\n" << "m_depthHeight = " << kFrameHeight << "\n"
+         << "m_calibrationDepthIntrinsic = 30 0 16 0 0 30 12 0 0 0 1 0 0 0 0 1\n"
+         << "m_frames.size = " << kFrames << "\n";
+    std::vector<uint16_t> depth(kFrameWidth * kFrameHeight);
+    std::vector<uint8_t> color(3 * kFrameWidth * kFrameHeight);
+    for (int frame_id = 0; frame_id < kFrames; frame_id++) {
+        std::ofstream pose(frame_config.GetPose(scan_id, frame_id));
+        pose << "1 0 0 " << 0.1f * frame_id << "\n0 1 0 " << 0.2f * scan << "\n0 0 1 0.5\n0 0 0 1\n";
+        for (size_t i = 0; i < depth.size(); i++)
+            depth[i] = (i % 7 == 0) ? 0 : 500 + (i * 13 + frame_id * 101 + scan) % 3000;
+        for (size_t i = 0; i < color.size(); i++)
+            color[i] = (i * 7 + frame_id * 31 + scan) % 256;
+        const cv::Mat depth_image(kFrameHeight, kFrameWidth, CV_16UC1, depth.data());
+        const cv::Mat color_image(kFrameHeight, kFrameWidth, CV_8UC3, color.data());
+        if (!pose.good() || !cv::imwrite(frame_config.GetDepth(scan_id, frame_id), depth_image) ||
+            !cv::imwrite(frame_config.GetColor(scan_id, frame_id), color_image))
+            return false;
+    }
+    return info.good();
+}
+
+// Writes 3RScan.json, objects.json and the class mapping with one reference and num_scans
+// rescans, and a labels ply and obj with num_vertices random vertices and a short sequence
+// for every rescan.
+const bool WriteSyntheticData(const std::string& data_path, const int num_scans, const int num_vertices) {
+    mkdir(data_path.c_str(), 0755);
+    const DataConfig data_config(data_path);
+    const FrameConfig frame_config(data_path);
+    std::ofstream json(data_config.GetJson());
+    std::ofstream objects(data_config.GetObjectJson());
+    std::ofstream mapping(data_config.GetMapping());
+    mapping << "Global ID,Label,NYU40 ID,Eigen13 ID,RIO27 ID\n";
+    for (int global_id = 1; global_id <= 100; global_id++)
+        mapping << global_id << ",object," << global_id % 41 << "," << global_id % 14 << "," << global_id % 28 << "\n";
+    json << "[{\"reference\": \"reference\", \"type\": \"train\", \"scans\": [";
+    objects << "{\"scans\": [";
+    uint32_t random = 1;
+    const auto next = [&random]() {
+        random = random * 1664525u + 1013904223u;
+        return random >> 8;
+    };
+    for (int scan = 0; scan < num_scans; scan++) {
+        const std::string scan_id = ScanId(scan);
+        mkdir((data_path + "/" + scan_id).c_str(), 0755);
+        // Rotation about z and a translation, column major.
+        const float angle = 0.1f * (scan + 1);
+        json << (scan ? ", " : "") << "{\"reference\": \"" << scan_id << "\", \"transform\": ["
+             << std::cos(angle) << ", " << std::sin(angle) << ", 0, 0, "
+             << -std::sin(angle) << ", " << std::cos(angle) << ", 0, 0, "
+             << "0, 0, 1, 0, " << scan << ", 1, 2, 1], \"rigid\": []}";
+        objects << (scan ? ", " : "") << "{\"scan\": \"" << scan_id << "\", \"objects\": [";
+        for (int instance = 1; instance <= kInstances; instance++)
+            objects << (instance > 1 ? ", " : "") << "{\"id\": \"" << instance << "\", \"global_id\": \""
+                    << (7 * instance + scan) % 100 + 1 << "\", \"label\": \"object\"}";
+        objects << "]}";
+        RIO::RIOPlyData ply;
+        std::ofstream obj(data_config.GetMesh(scan_id));
+        for (int i = 0; i < num_vertices; i++) {
+            float position[3];
+            for (float& coordinate: position)
+                coordinate = (next() % 10000) / 1000.0f;
+            ply.vertices.insert(ply.vertices.end(), position, position + 3);
+            for (int channel = 0; channel < 3; channel++)
+                ply.colors.push_back(next() % 256);
+            ply.object_ids.push_back(next() % (kInstances + 1));
+            ply.NYU40.push_back(next() % 41);
+            ply.Eigen13.push_back(next() % 14);
+            ply.RIO27.push_back(next() % 28);
+            obj << "v " << position[0] << " " << position[1] << " " << position[2] << "\n";
+        }
+        for (int i = 0; i + 2 < num_vertices; i += 3) {
+            for (int corner = 0; corner < 3; corner++)
+                ply.faces.push_back(i + corner);
+            obj << "f " << i + 1 << " " << i + 2 << " " << i + 3 << "\n";
+        }
+        if (!ply.save(data_config.GetInstance(scan_id), true) || !obj.good() ||
+            !WriteSyntheticFrames(frame_config, scan_id, scan))
+            return false;
+    }
+    json << "]}]";
+    objects << "]}";
+    return json.good() && objects.good() && mapping.good();
+}
+
+// Aligned camera poses of a scan, written by the stress test from GetCameraPoses().
+const std::string PosesFile(const DataConfig& data_config, const std::string& scan_id) {
+    return data_config.base_path + "/" + scan_id + "/poses.align.txt";
+}
+
+// Files written by the operations on a scan.
+const std::vector<std::string> Outputs(const DataConfig& data_config, const std::string& scan_id) {
+    std::vector<std::string> outputs = {
+        data_config.GetInstance(scan_id, ".align"), data_config.GetMesh(scan_id, ".align"),
+        data_config.GetInstance(scan_id, ".global"), data_config.GetInstance(scan_id, ".ascii"),
+        data_config.GetInstance(scan_id, ".nyu40"), data_config.GetInstance(scan_id, ".eigen13"),
+        data_config.GetInstance(scan_id, ".rio27"), data_config.GetInstanceArchive(scan_id),
+        PosesFile(data_config, scan_id) };
+    for (int instance = 1; instance <= kInstances; instance++)
+        outputs.push_back(data_config.GetMesh(scan_id, ".align.instance." + std::to_string(instance)));
+    const FrameConfig frame_config(data_config.base_path);
+    for (int frame_id = 0; frame_id < kFrames; frame_id++)
+        outputs.push_back(frame_config.GetPly(scan_id, frame_id));
+    return outputs;
+}
+
+const std::string ReadFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+const bool WaitAll(std::vector<std::future<bool>>& futures) {
+    bool success = true;
+    for (std::future<bool>& future: futures)
+        success &= future.get();
+    return success;
+}
+
+const bool TransformInstances(const RIO::RIO& rio, const std::string& scan_id, const Variant variant) {
+    if (variant == Variant::AllInstances) {
+        RIO::InstanceExportOptions options;
+        options.num_threads = 2;
+        return rio.TransformAllInstances(scan_id, options);
+    }
+    std::vector<std::future<bool>> futures;
+    bool success = true;
+    for (int instance = 1; instance <= kInstances; instance++) {
+        if (variant == Variant::Async)
+            futures.push_back(rio.TransformInstanceAsync(scan_id, instance));
+        else
+            success &= rio.TransformInstance(scan_id, instance);
+    }
+    return WaitAll(futures) && success;
+}
+
+const bool Backproject(const RIO::RIO& rio, const std::string& scan_id, const Variant variant) {
+    std::vector<std::future<bool>> futures;
+    bool success = true;
+    for (int frame_id = 0; frame_id < kFrames; frame_id++) {
+        if (variant == Variant::Async)
+            futures.push_back(rio.BackprojectAsync(scan_id, frame_id, true));
+        else
+            success &= rio.Backproject(scan_id, frame_id, true);
+    }
+    return WaitAll(futures) && success;
+}
+
+const bool SavePoses(const RIO::RIO& rio, const DataConfig& data_config, const std::string& scan_id) {
+    Eigen::Matrix4Xf poses;
+    if (rio.GetCameraPoses(scan_id, poses, true) != kFrames)
+        return false;
+    std::ofstream file(PosesFile(data_config, scan_id));
+    file << poses << "\n";
+    return file.good();
+}
+
+const bool RunOperation(const RIO::RIO& rio, const DataConfig& data_config, const std::string& scan_id,
+                        const int operation, const Variant variant) {
+    const bool async = (variant == Variant::Async);
+    switch (operation) {
+        case 0: return async ? rio.Transform2ReferenceAsync(scan_id).get() : rio.Transform2Reference(scan_id);
+        case 1: return async ? rio.RemapLabelsPlyAsync(scan_id).get() : rio.RemapLabelsPly(scan_id);
+        case 2: return async ? rio.ReSavePLYASCIIAsync(scan_id).get() : rio.ReSavePLYASCII(scan_id);
+        case 3: {
+            bool success = true;
+            for (const RIO::LabelSet set: kLabelSets)
+                success &= rio.RemapLabelsPly(scan_id, set);
+            return success;
+        }
+        case 4: return TransformInstances(rio, scan_id, variant);
+        case 5: {
+            RIO::InstanceExportOptions options;
+            options.single_archive = true;
+            options.num_threads = 2;
+            return rio.TransformAllInstances(scan_id, options);
+        }
+        case 6: return Backproject(rio, scan_id, variant);
+        default: return SavePoses(rio, data_config, scan_id);
+    }
+}
+
+}  // namespace
+
+// Runs every operation of RIO (Transform2Reference, RemapLabelsPly with and without a
+// label set, ReSavePLYASCII, TransformInstance, TransformAllInstances, Backproject and
+// GetCameraPoses) on a synthetic data set from many threads with one RIO instance and
+// compares the outputs with the ones of a serial run. The rounds alternate between the
+// synchronous calls, the *Async calls and writing the instances with TransformAllInstances,
+// for example:
+// rio_stress /tmp/rio_stress 16
+// Build with -fsanitize=thread to check for data races.
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cout << "usage: rio_stress <output_path> [num_threads] [num_scans] [num_vertices] [rounds]" << std::endl;
+        return 0;
+    }
+    const std::string data_path{argv[1]};
+    const int num_threads = (argc > 2) ? std::stoi(argv[2]) : std::max(2u, std::thread::hardware_concurrency());
+    const int num_scans = (argc > 3) ? std::stoi(argv[3]) : 8;
+    const int num_vertices = (argc > 4) ? std::stoi(argv[4]) : 30000;
+    const int rounds = (argc > 5) ? std::stoi(argv[5]) : 4;
+    RIO::SetLogLevel(RIO::LogLevel::Warning);
+    if (!WriteSyntheticData(data_path, num_scans, num_vertices)) {
+        std::cout << "can not write synthetic data to " << data_path << std::endl;
+        return 1;
+    }
+    const DataConfig data_config(data_path);
+    RIO::RIOConfig config(data_path);
+    // Every round has to compute its outputs.
+    config.cache_outputs = false;
+    const RIO::RIO rio(config);
+
+    std::map<std::string, std::string> expected;
+    for (int scan = 0; scan < num_scans; scan++) {
+        for (int operation = 0; operation < kOperations; operation++) {
+            if (!RunOperation(rio, data_config, ScanId(scan), operation, Variant::Sync)) {
+                RIO::FlushLog();
+                std::cout << "serial run failed on " << ScanId(scan) << std::endl;
+                return 1;
+            }
+        }
+        for (const std::string& output: Outputs(data_config, ScanId(scan)))
+            expected[output] = ReadFile(output);
+    }
+
+    size_t failures = 0;
+    for (int round = 0; round < rounds; round++) {
+        for (const auto& output: expected)
+            std::remove(output.first.c_str());
+        const Variant variant = static_cast<Variant>(round % 3);
+        // Neighbouring tasks work on the same scan, so threads share its inputs and cache entries.
+        std::atomic<int> next_task{0};
+        std::atomic<size_t> failed{0};
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < num_threads; thread++) {
+            threads.emplace_back([&]() {
+                for (int task = next_task++; task < num_scans * kOperations; task = next_task++) {
+                    if (!RunOperation(rio, data_config, ScanId(task / kOperations), task % kOperations, variant))
+                        failed++;
+                }
+            });
+        }
+        for (std::thread& thread: threads)
+            thread.join();
+        RIO::FlushLog();
+        size_t mismatches = 0;
+        for (const auto& output: expected) {
+            if (ReadFile(output.first) != output.second) {
+                std::cout << "round " << round << ": " << output.first << " differs from the serial run" << std::endl;
+                mismatches++;
+            }
+        }
+        std::cout << "round " << round << " (" << kVariantNames[round % 3] << "): " << num_threads << " threads, " << failed << " failed operations, "
+                  << mismatches << " mismatching outputs" << std::endl;
+        failures += failed + mismatches;
+    }
+    RIO::FlushLog();
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,57 @@
+/*******************************************************
+* Copyright (c) 2020, Johanna Wald
+* All rights reserved.
+*
+* This file is distributed under the GNU Lesser General Public License v3.0.
+* The complete license agreement can be obtained at:
+* http://www.gnu.org/licenses/lgpl-3.0.html
+********************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+#include "rio_lib/thread_pool.h"
+
+namespace RIO {
+
+// Encodes and writes the outputs of the renderer on a pool of threads, so that the
+// render thread only draws and reads back. At most capacity writes are queued or
+// running, a further write blocks until one of them finished. The first failed write
+// is rethrown by the next call of Write* or Wait.
+class FrameWriter {
+public:
+    // num_threads = 0 uses all hardware threads, capacity = 0 twice as many writes.
+    FrameWriter(const unsigned num_threads = 0, const size_t capacity = 0);
+    // Waits for all writes, a failure that was not rethrown yet is logged.
+    ~FrameWriter();
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+    // Writes the image with cv::imwrite. The pixels are shared, not copied, so the
+    // image must not be modified afterwards (assigning a new cv::Mat is fine).
+    void WriteImage(const std::string& filename, const cv::Mat& image);
+    void WriteText(const std::string& filename, const std::string& text);
+    // Blocks until all writes have finished and rethrows the first failure.
+    void Wait();
+private:
+    const size_t capacity_;
+    // Protects in_flight_ and error_.
+    std::mutex mutex_;
+    std::condition_variable done_;
+    size_t in_flight_{0};
+    std::exception_ptr error_;
+    // Last member, so the workers are joined before the state above is destroyed.
+    ThreadPool pool_;
+
+    void Submit(std::function<void()> write);
+    // Rethrows and clears error_, the lock must be held.
+    void Rethrow();
+};
+
+}; // namespace RIO
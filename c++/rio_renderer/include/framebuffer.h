@@ -0,0 +1,52 @@
+/*******************************************************
+* Copyright (c) 2020, Johanna Wald
+* All rights reserved.
+*
+* This file is distributed under the GNU Lesser General Public License v3.0.
+* The complete license agreement can be obtained at:
+* http://www.gnu.org/licenses/lgpl-3.0.html
+********************************************************/
+
+#pragma once
+
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+namespace RIO {
+
+// Offscreen framebuffer object of a fixed size with renderbuffer attachments.
+// The renderer draws and reads all images through it, independent of the window
+// (or the missing window) of the context.
+class Framebuffer {
+public:
+    Framebuffer(const int width, const int height);
+    ~Framebuffer();
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+    // Adds a color attachment with the given internal format (e.g. GL_RGBA8) and
+    // returns its index (GL_COLOR_ATTACHMENT0 + index).
+    int AddColor(const GLenum internal_format);
+    void AddDepth(const GLenum internal_format = GL_DEPTH_COMPONENT24);
+    // Checks completeness after all attachments are added.
+    bool Complete();
+    // Clears the depth and all color attachments, integer attachments (e.g. GL_R16UI) to 0.
+    void Clear(const float red, const float green, const float blue, const float alpha) const;
+    // Binds the framebuffer for drawing and reading and sets the viewport.
+    void Bind() const;
+    // Selects the color attachment that glReadPixels reads from.
+    void ReadFrom(const int attachment) const;
+    int width() const { return width_; }
+    int height() const { return height_; }
+private:
+    const int width_;
+    const int height_;
+    GLuint framebuffer_{0};
+    std::vector<GLuint> renderbuffers_;
+    std::vector<GLenum> draw_buffers_;
+    std::vector<bool> integer_;
+    GLuint AddRenderbuffer(const GLenum internal_format, const GLenum attachment);
+};
+
+}; // namespace RIO
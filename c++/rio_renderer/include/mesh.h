@@ -30,6 +30,8 @@ struct Vertex {
     glm::vec2 TexCoords;
     // Color
     glm::vec3 Color;
+    // Instance (objectId of the labels ply, 0 for unlabeled meshes)
+    GLuint Instance;
 };
 
 struct Texture {
@@ -88,6 +90,13 @@ public:
             glBindTexture(GL_TEXTURE_2D, 0);
         }
     }
+
+    // Draws count indices from first on (e.g. the faces of one instance) without textures.
+    void DrawElements(const size_t first, const size_t count) const {
+        glBindVertexArray(this->VAO);
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (GLvoid *)(first * sizeof(GLuint)));
+        glBindVertexArray(0);
+    }
     
 private:
     // Render data
@@ -125,6 +134,9 @@ private:
         // Vertex Texture Coords
         glEnableVertexAttribArray(3);
         glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid *)offsetof(Vertex, Color));
+        // Vertex Instance Id (integer attribute, not normalized)
+        glEnableVertexAttribArray(4);
+        glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(Vertex), (GLvoid *)offsetof(Vertex, Instance));
         
         glBindVertexArray(0);
     }
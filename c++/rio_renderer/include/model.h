@@ -26,15 +26,38 @@
 #include <assimp/postprocess.h>
 
 #include "mesh.h"
+#include "rio_lib/log.h"
+#include "rio_lib/obj_loader.h"
 #include "shader.h"
+#include "third_party/tinyply.h"
 
 class Model {
 public:
     // Constructor, expects a filepath to a 3D model.
-    Model(const std::string& path, const glm::vec3& rgb_color_filter = glm::vec3(-1, -1, -1)): rgb_color_filter_(rgb_color_filter) {
-        use_rgb_color_filter_ = rgb_color_filter_ != glm::vec3(-1, -1, -1);
+    Model(const std::string& path) {
         this->loadModel(path);
     }
+
+    // Loads a textured obj file together with the colors and objectIds of its labels ply
+    // (e.g. mesh.refined.v2.obj and labels.instances.annotated.v2.ply), so that a single
+    // draw renders color and labels. Falls back to the obj only if the faces differ.
+    Model(const std::string& path, const std::string& labels_path) {
+        this->directory_ = path.substr(0, path.find_last_of('/'));
+        this->loadObj(path, labels_path);
+    }
+
+    // True if the vertices carry the colors and objectIds of a labels ply.
+    bool labeled() const { return labeled_; }
+
+    // Draws only the faces of one instance (see sortByInstance), the shader must be in use.
+    void DrawInstance(const int instance) const {
+        if (this->meshes_.empty() || instance < 0 || instance + 1 >= static_cast<int>(instance_offsets_.size()))
+            return;
+        const GLuint begin = instance_offsets_[instance];
+        const GLuint end = instance_offsets_[instance + 1];
+        if (end > begin)
+            this->meshes_[0].DrawElements(begin, end - begin);
+    }
     
     // Draws the model, and thus all its meshes
     void Draw(Shader shader) {
@@ -66,11 +89,9 @@ private:
         return textureID;
     }
 
-    // color filter: only load vertices with this color: when a face contains at least one vertex with this color it is kept, otherwise it is discarded.
-    const glm::vec3 rgb_color_filter_;
-
-    // if the rgb_color_filter should be applied when loading the meshes for this model
-    bool use_rgb_color_filter_{false};
+    bool labeled_{false};
+    // instance_offsets_[i] is the first index of the faces of instance i (size: max id + 2).
+    std::vector<GLuint> instance_offsets_;
 
     //  Model Data
     std::vector<Mesh> meshes_;
@@ -80,19 +101,158 @@ private:
     
     // Loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(const std::string& path) {
+        // Retrieve the directory path of the filepath
+        this->directory_ = path.substr(0, path.find_last_of('/'));
+        // obj files (mesh.refined.v2.obj) go through the parallel parser of rio_lib.
+        if (path.size() > 4 && path.compare(path.size() - 4, 4, ".obj") == 0) {
+            this->loadObj(path);
+            return;
+        }
+        // ply files (labels.instances.annotated.v2.ply) are read with tinyply to get the objectId.
+        if (path.size() > 4 && path.compare(path.size() - 4, 4, ".ply") == 0) {
+            this->loadPly(path);
+            return;
+        }
         // Read file via ASSIMP
         Assimp::Importer importer;
         const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
         if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-            std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+            RIO_LOG(Error) << "ASSIMP:: " << importer.GetErrorString();
             return;
         }
-        // Retrieve the directory path of the filepath
-        this->directory_ = path.substr(0, path.find_last_of('/'));
         // Process ASSIMP's root node recursively
         this->processNode(scene->mRootNode, scene);
     }
     
+    // Loads an obj file with RIO::LoadObj. Like ASSIMP, every face corner becomes its own
+    // vertex and the texture coordinates are flipped (aiProcess_FlipUVs). With a labels ply
+    // the corners get the color and objectId of the corresponding ply vertex; the faces of
+    // both files correspond one to one (see RIO::TransformInstance).
+    void loadObj(const std::string& path, const std::string& labels_path = "") {
+        RIO::ObjMesh obj;
+        if (!RIO::LoadObj(path, obj)) {
+            RIO_LOG(Error) << "OBJ:: failed to load " << path;
+            return;
+        }
+        std::vector<Vertex> vertices(obj.position_indices.size());
+        std::vector<GLuint> indices(obj.position_indices.size());
+        for (size_t i = 0; i < obj.position_indices.size(); i++) {
+            Vertex& vertex = vertices[i];
+            const size_t p = 3 * obj.position_indices[i];
+            vertex.Position = glm::vec3(obj.positions[p], obj.positions[p + 1], obj.positions[p + 2]);
+            vertex.Normal = glm::vec3(0.0f, 0.0f, 0.0f);
+            vertex.Color = glm::vec3(0.0f, 0.0f, 0.0f);
+            vertex.Instance = 0;
+            if (!obj.normal_indices.empty()) {
+                const size_t n = 3 * obj.normal_indices[i];
+                vertex.Normal = glm::vec3(obj.normals[n], obj.normals[n + 1], obj.normals[n + 2]);
+            }
+            if (!obj.uv_indices.empty()) {
+                const size_t t = 2 * obj.uv_indices[i];
+                vertex.TexCoords = glm::vec2(obj.uvs[t], 1.0f - obj.uvs[t + 1]);
+            } else vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+            indices[i] = static_cast<GLuint>(i);
+        }
+        if (!labels_path.empty()) {
+            std::vector<float> positions;
+            std::vector<uint8_t> colors;
+            std::vector<uint16_t> object_ids;
+            std::vector<uint32_t> faces;
+            const size_t num_ply_vertices = readPly(labels_path, positions, colors, object_ids, faces);
+            if (faces.size() == vertices.size() && colors.size() == 3 * num_ply_vertices &&
+                object_ids.size() == num_ply_vertices) {
+                for (size_t i = 0; i < vertices.size(); i++) {
+                    const uint32_t v = faces[i];
+                    vertices[i].Color = glm::vec3(colors[3 * v] / 255.0f, colors[3 * v + 1] / 255.0f, colors[3 * v + 2] / 255.0f);
+                    vertices[i].Instance = object_ids[v];
+                }
+                labeled_ = true;
+                this->sortByInstance(vertices, indices);
+            } else {
+                RIO_LOG(Warning) << "PLY:: faces of " << labels_path << " do not match " << path;
+            }
+        }
+        std::vector<Texture> textures;
+        if (!obj.material_library.empty()) {
+            const std::string texture_file = RIO::LoadObjTexture(this->directory_ + "/" + obj.material_library);
+            if (!texture_file.empty()) {
+                Texture texture;
+                texture.id = TextureFromFileTest(texture_file.c_str(), this->directory_);
+                texture.type = "texture_diffuse";
+                texture.path = aiString(texture_file);
+                textures.push_back(texture);
+                this->textures_loaded_.push_back(texture);
+            }
+        }
+        this->meshes_.push_back(Mesh(vertices, indices, textures));
+    }
+
+    // Loads the vertices (position, color and objectId as instance) and faces of a labels ply.
+    void loadPly(const std::string& path) {
+        std::vector<float> positions;
+        std::vector<uint8_t> colors;
+        std::vector<uint16_t> object_ids;
+        std::vector<uint32_t> faces;
+        const size_t num_vertices = readPly(path, positions, colors, object_ids, faces);
+        if (num_vertices == 0)
+            return;
+        std::vector<Vertex> vertices(num_vertices);
+        for (size_t i = 0; i < num_vertices; i++) {
+            Vertex& vertex = vertices[i];
+            vertex.Position = glm::vec3(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+            vertex.Normal = glm::vec3(0.0f, 0.0f, 0.0f);
+            vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+            vertex.Color = glm::vec3(0.0f, 0.0f, 0.0f);
+            if (colors.size() == 3 * num_vertices)
+                vertex.Color = glm::vec3(colors[3 * i] / 255.0f, colors[3 * i + 1] / 255.0f, colors[3 * i + 2] / 255.0f);
+            vertex.Instance = (object_ids.size() == num_vertices) ? object_ids[i] : 0;
+        }
+        std::vector<GLuint> indices(faces.begin(), faces.begin() + faces.size() / 3 * 3);
+        if (object_ids.size() == num_vertices)
+            this->sortByInstance(vertices, indices);
+        this->meshes_.push_back(Mesh(vertices, indices, std::vector<Texture>()));
+    }
+
+    // Sorts the faces by instance with a counting sort, so that the faces of every instance
+    // are drawn with one range of the index buffer. The instance of a face is the one of its
+    // last vertex: with flat shading it determines the instance id of the pixels.
+    void sortByInstance(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices) {
+        GLuint max_instance = 0;
+        for (size_t i = 2; i < indices.size(); i += 3)
+            max_instance = std::max(max_instance, vertices[indices[i]].Instance);
+        instance_offsets_.assign(max_instance + 2, 0);
+        for (size_t i = 2; i < indices.size(); i += 3)
+            instance_offsets_[vertices[indices[i]].Instance + 1] += 3;
+        for (size_t i = 1; i < instance_offsets_.size(); i++)
+            instance_offsets_[i] += instance_offsets_[i - 1];
+        std::vector<GLuint> next(instance_offsets_.begin(), instance_offsets_.end() - 1);
+        std::vector<GLuint> sorted(indices.size());
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            GLuint& position = next[vertices[indices[i + 2]].Instance];
+            std::copy(&indices[i], &indices[i] + 3, &sorted[position]);
+            position += 3;
+        }
+        indices.swap(sorted);
+    }
+
+    // Reads positions, colors, objectIds and faces (3 indices each) of a labels ply and
+    // returns the number of vertices.
+    size_t readPly(const std::string& path, std::vector<float>& positions, std::vector<uint8_t>& colors,
+                   std::vector<uint16_t>& object_ids, std::vector<uint32_t>& faces) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            RIO_LOG(Error) << "PLY:: failed to load " << path;
+            return 0;
+        }
+        tinyply::PlyFile ply(file);
+        ply.request_properties_from_element("vertex", { "x", "y", "z" }, positions);
+        ply.request_properties_from_element("vertex", { "red", "green", "blue" }, colors);
+        ply.request_properties_from_element("vertex", { "objectId" }, object_ids);
+        ply.request_properties_from_element("face", { "vertex_indices" }, faces, 3);
+        ply.read(file);
+        return positions.size() / 3;
+    }
+
     // Processes a node in a recursive fashion.
     // Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
     void processNode(aiNode* node, const aiScene* scene) {
@@ -113,12 +273,11 @@ private:
         std::vector<Vertex> vertices;
         std::vector<GLuint> indices;
         std::vector<Texture> textures;
-        
-        std::map<GLuint, bool> filteredIndices; // list of indices of all vertices whose color are not the filter color, if colors should be filtered
 
         // Walk through each of the mesh's vertices
         for (GLuint i = 0; i < mesh->mNumVertices; i++) {
             Vertex vertex;
+            vertex.Instance = 0;
             // Declare a placeholder vector since assimp uses its own vector class
             // that doesn't directly convert to glm's vec3 class so we transfer the
             // data to this placeholder glm::vec3 first.
@@ -140,10 +299,6 @@ private:
                 vector.y = mesh->mColors[0][i].g;
                 vector.z = mesh->mColors[0][i].b;
                 vertex.Color = vector;
-                if (use_rgb_color_filter_ && vertex.Color != rgb_color_filter_) {
-                    // if vertex does not have the correct color, filter its index.
-                    filteredIndices[i] = true;
-                }
             }
             // Texture Coordinates
             // Does the mesh contain texture coordinates?
@@ -157,40 +312,14 @@ private:
             }
             else
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-            vertices.push_back(vertex); // we still add filtered vertices since faces reference original indices
+            vertices.push_back(vertex);
         }
         // Now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-
-        // variables for each iteration of the for-loop, instantiated once for reserved memory and higher efficiency
-        bool face_contains_non_filtered_index = false; // at least one index is not filtered in this face?
-        std::vector<GLuint> indices_of_face; // the indices of the current face
-
         for (GLuint i = 0; i < mesh->mNumFaces; i++) {
             aiFace face = mesh->mFaces[i];
-            
             // Retrieve all indices of the face and store them in the indices vector
-            for (GLuint j = 0; j < face.mNumIndices; j++) {
-                indices_of_face.push_back(face.mIndices[j]);
-            }
-
-            // Check if at least one index is not filtered in this face
-            for (const auto& index : indices_of_face) {
-                if (filteredIndices.find(index) == filteredIndices.end() ){
-                    face_contains_non_filtered_index = true;
-                    break;
-                }
-            }
-
-            // Add indices to list if at least one index is not filtered in this face (otherwise ignore the whole face!)
-            if (face_contains_non_filtered_index) {
-                for (const auto& index : indices_of_face) {
-                    indices.push_back(index);
-                }
-            }
-
-            // reset variables for next iteration
-            face_contains_non_filtered_index = false;
-            indices_of_face.clear();
+            for (GLuint j = 0; j < face.mNumIndices; j++)
+                indices.push_back(face.mIndices[j]);
         }
         // Process materials
         if (mesh->mMaterialIndex >= 0) {
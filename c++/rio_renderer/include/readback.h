@@ -0,0 +1,54 @@
+/*******************************************************
+* Copyright (c) 2020, Johanna Wald
+* All rights reserved.
+*
+* This file is distributed under the GNU Lesser General Public License v3.0.
+* The complete license agreement can be obtained at:
+* http://www.gnu.org/licenses/lgpl-3.0.html
+********************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+namespace RIO {
+
+// Ring of pixel pack buffers for asynchronous readback. Every slot holds one buffer
+// per image of a frame. glReadPixels into a pack buffer returns right away, the
+// transfer runs in the background until the fence of the slot is signaled, so the
+// next frame can be drawn in the meantime.
+class ReadbackRing {
+public:
+    // sizes are the bytes of every image of a slot.
+    ReadbackRing(const int slots, const std::vector<size_t>& sizes);
+    ~ReadbackRing();
+    ReadbackRing(const ReadbackRing&) = delete;
+    ReadbackRing& operator=(const ReadbackRing&) = delete;
+    // Starts reading the current read buffer (width x height from the origin) into
+    // an image of the slot, same arguments as glReadPixels.
+    void Read(const int slot, const int image, const int width, const int height,
+              const GLenum format, const GLenum type);
+    // Marks the end of the reads of a slot.
+    void Fence(const int slot);
+    // Waits until the transfers of a fenced slot have finished.
+    void Wait(const int slot);
+    // Maps an image of a finished slot, the data is valid until Unmap. Returns nullptr
+    // (and logs an error) if the buffer can not be mapped, it must not be unmapped then.
+    const void* Map(const int slot, const int image);
+    void Unmap(const int slot, const int image);
+    // True if the slot is fenced but not waited for.
+    bool pending(const int slot) const { return fences_[slot] != nullptr; }
+    int slots() const { return static_cast<int>(fences_.size()); }
+private:
+    const std::vector<size_t> sizes_;
+    // slots x images buffers
+    std::vector<GLuint> buffers_;
+    std::vector<GLsync> fences_;
+    GLuint buffer(const int slot, const int image) const { return buffers_[slot * sizes_.size() + image]; }
+};
+
+}; // namespace RIO
@@ -0,0 +1,36 @@
+/*******************************************************
+* Copyright (c) 2020, Johanna Wald
+* All rights reserved.
+*
+* This file is distributed under the GNU Lesser General Public License v3.0.
+* The complete license agreement can be obtained at:
+* http://www.gnu.org/licenses/lgpl-3.0.html
+********************************************************/
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+namespace RIO {
+
+// Window opens a (GLFW) window and needs a display server. Headless creates a
+// surfaceless EGL context, it also runs on nodes without a GPU with Mesa's
+// software rasterizer (e.g. LIBGL_ALWAYS_SOFTWARE=1).
+enum class RenderBackend { Window, Headless };
+
+// Parses "window" or "headless", returns false if unknown.
+bool ParseRenderBackend(const std::string& name, RenderBackend& backend);
+// Backend given by the RIO_RENDER_BACKEND environment variable, Window if not set.
+RenderBackend DefaultRenderBackend();
+
+// OpenGL 3.3 core context. The renderer always draws into its own framebuffer
+// object, so the context needs no default framebuffer of a particular size.
+class RenderContext {
+public:
+    virtual ~RenderContext() { }
+    // Creates the context and makes it current, nullptr if that is not possible.
+    static std::unique_ptr<RenderContext> Create(const RenderBackend backend, const int width, const int height);
+};
+
+}; // namespace RIO
@@ -12,16 +12,21 @@
 #define GLEW_STATIC
 #include <GL/glew.h>
 
-#include <GLFW/glfw3.h>
 #include <Eigen/Dense>
+#include <memory>
 
 #include "data.h"
+#include "framebuffer.h"
 #include "intrinsics.h"
 #include "model.h"
+#include "render_context.h"
 #include "shader.h"
 
 namespace RIO {
 
+class FrameWriter;
+class ReadbackRing;
+
 constexpr float kNearPlane{0.1f};
 constexpr float kFarPlane{10.0f};
 
@@ -37,9 +42,12 @@ public:
              float fov_scale = 1.0f,
              bool v2 = true);
     ~Renderer();
-    int Init();
+    int Init(const RenderBackend backend = DefaultRenderBackend());
+    // Renders one frame and returns once its outputs are written.
     void Render(const bool inc_frame_id, const std::string save_path = "");
     void Render(const int frame_id, const std::string save_path = "");
+    // Renders and saves all frames. Unless occlusions are computed, the readback is
+    // asynchronous: a frame is drawn while the previous ones transfer and are saved.
     void RenderAllFrames(const std::string save_path = "");
     const cv::Mat& GetLabels() const;
     const cv::Mat& GetColor() const;
@@ -66,6 +74,7 @@ public:
 private:
     std::string data_path_{""};
     std::string sequence_path_{""};
+    // Size of the stored (rotated) images and of the framebuffer.
     int buffer_width{0};
     int buffer_height{0};
     bool save_images_{true};
@@ -100,23 +109,48 @@ private:
     Data data_fov_scale_;
     Eigen::Matrix4f projection_{Eigen::Matrix4f::Identity()};
 
-    GLFWwindow *window{nullptr};
+    // The framebuffer has to be released before the context.
+    std::unique_ptr<RenderContext> context_;
+    std::unique_ptr<Framebuffer> framebuffer_;
+    std::unique_ptr<FrameWriter> writer_;
     Shader* shader_labels_{nullptr};
     Shader* shader_RGB_{nullptr};
+    // Textured mesh, labeled with the colors and objectIds of the labels ply if possible.
     Model* model_RGB_{nullptr};
+    // Labels ply, only loaded if the textured mesh is not labeled or not needed.
     Model* model_labels_{nullptr};
-    std::map<int, Model*> instance2model_with_instance_only_;
+    // Instances visible in the last frame with occlusion scores.
+    std::vector<int> visible_instances_;
+    // Two GL_SAMPLES_PASSED queries (visible and unoccluded pixels) per visible instance.
+    std::vector<GLuint> occlusion_queries_;
     bool v2_{true};
 
-    void InitGLFW();
+    // Renders a frame and hands its outputs to the writer without waiting for them.
+    void RenderFrame(const bool inc_frame_id, const std::string& save_path);
     void Render(Model& model, Shader& shader);
     void ReadLabels(cv::Mat& image, cv::Mat& labels);
     void ReadRGB(cv::Mat& image);
     void ReadDepth(cv::Mat& image);
-    void CalcTruncations(std::map<int, unsigned long>& instances2color, std::map<int, VisibilityEntry>& instances2truncation, const cv::Mat& labels_fov_scale);
-    void CalcOcclusions(std::map<int, unsigned long>& instances2color, std::map<int, VisibilityEntry>& instances2occlusion, const cv::Mat& labels);
+    void UpdateBoundingBoxes(const cv::Mat& instances);
+    // Copies the images of a finished readback slot into rio_data_, false if a buffer
+    // can not be mapped.
+    bool CopyReadback(ReadbackRing& ring, const int slot, const bool labels);
+    // Queues the images and the bounding boxes of rio_data_ (frame-xxxxxx prefix).
+    void SaveFrame(const std::string& filename);
+    void ClearFrameData();
+    // Replaces visible (the instances of the last frame) by the labeled instances with
+    // pixels in the instance image.
+    void VisibleInstances(const cv::Mat& instances, std::vector<int>& visible) const;
+    void CalcTruncations(const std::vector<int>& visible, std::map<int, VisibilityEntry>& instances2truncation, const cv::Mat& instances_fov_scale);
+    // Counts the visible and the unoccluded pixels of the visible instances with
+    // GL_SAMPLES_PASSED queries.
+    void CalcOcclusions(const std::vector<int>& visible, std::map<int, VisibilityEntry>& instances2occlusion);
     void VerifyTruncationAndOcclusion(std::map<int, VisibilityEntry>& instances2occlusion, std::map<int, VisibilityEntry>& instances2truncation);
+    // Draws the labels model, or the labeled mesh if the labels are part of it.
+    void DrawLabels();
     void DrawScene(Model& model, Shader& shader);
+    // Projection of the intrinsics that renders the images in their stored orientation.
+    Eigen::Matrix4f Projection(const Intrinsics& intrinsics) const;
     bool LoadObjects(const std::string& obj_file);
 };
 
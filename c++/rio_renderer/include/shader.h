@@ -15,6 +15,8 @@
 #include <sstream>
 #include <string>
 
+#include "rio_lib/log.h"
+
 class Shader {
 public:
     GLuint Program;
@@ -44,7 +46,7 @@ public:
             fragmentCode = fShaderStream.str();
         }
         catch (std::ifstream::failure e) {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            RIO_LOG(Error) << "SHADER::FILE_NOT_SUCCESFULLY_READ";
         }
         const GLchar *vShaderCode = vertexCode.c_str();
         const GLchar *fShaderCode = fragmentCode.c_str();
@@ -60,7 +62,7 @@ public:
         glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
         if (!success) {
             glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+            RIO_LOG(Error) << "SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog;
         }
         // Fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
@@ -70,7 +72,7 @@ public:
         glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
         if (!success) {
             glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+            RIO_LOG(Error) << "SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog;
         }
         // Shader Program
         this->Program = glCreateProgram();
@@ -81,7 +83,7 @@ public:
         glGetProgramiv(this->Program, GL_LINK_STATUS, &success);
         if (!success) {
             glGetProgramInfoLog(this->Program, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+            RIO_LOG(Error) << "SHADER::PROGRAM::LINKING_FAILED\n" << infoLog;
         }
         // Delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
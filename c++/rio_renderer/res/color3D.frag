@@ -1,9 +1,15 @@
 #version 330 core
 
 flat in vec3 colorV;
-out vec4 color;
+flat in uint instanceV;
+layout ( location = 1 ) out uint instance;
+layout ( location = 2 ) out uint depth;
+layout ( location = 3 ) out vec4 label;
 
 void main( )
 {
-    color = vec4(colorV, 1.0);
+    instance = instanceV;
+    // gl_FragCoord.w is 1 / w of the clip coordinates, i.e. 1 / depth (m) in camera space
+    depth = uint(min(1000.0 / gl_FragCoord.w, 65535.0));
+    label = vec4(colorV, 1.0);
 }
\ No newline at end of file
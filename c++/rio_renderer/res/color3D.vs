@@ -3,8 +3,10 @@ layout ( location = 0 ) in vec3 position;
 layout ( location = 1 ) in vec3 normal;
 layout ( location = 2 ) in vec2 texCoords;
 layout ( location = 3 ) in vec3 color;
+layout ( location = 4 ) in uint instance;
 
 flat out vec3 colorV;
+flat out uint instanceV;
 
 uniform mat4 model_view_projection;
 
@@ -12,4 +14,5 @@ void main( )
 {
     gl_Position = model_view_projection * vec4( position, 1.0f );
     colorV = color;
+    instanceV = instance;
 }
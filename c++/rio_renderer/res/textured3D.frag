@@ -1,11 +1,21 @@
 #version 330 core
 
 in vec2 TexCoords;
-out vec4 color;
+flat in vec3 colorV;
+flat in uint instanceV;
+layout (location = 0) out vec4 color;
+layout (location = 1) out uint instance;
+layout (location = 2) out uint depth;
+layout (location = 3) out vec4 label;
 
 uniform sampler2D texture_diffuse;
 
 void main()
 {
     color = vec4(texture(texture_diffuse, TexCoords));
+    // color and objectId of the labels ply, 0 if the mesh is not labeled
+    instance = instanceV;
+    // linear depth in mm, gl_FragCoord.w is 1 / depth (m) in camera space
+    depth = uint(min(1000.0 / gl_FragCoord.w, 65535.0));
+    label = vec4(colorV, 1.0);
 }
\ No newline at end of file
@@ -2,8 +2,12 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoords;
+layout (location = 3) in vec3 color;
+layout (location = 4) in uint instance;
 
 out vec2 TexCoords;
+flat out vec3 colorV;
+flat out uint instanceV;
 
 uniform mat4 model_view_projection;
 
@@ -11,4 +15,6 @@ void main()
 {
     gl_Position = model_view_projection * vec4(position, 1.0f);
     TexCoords = texCoords;
-}
\ No newline at end of file
+    colorV = color;
+    instanceV = instance;
+}
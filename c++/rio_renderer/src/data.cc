@@ -13,6 +13,7 @@
 #include <iostream>
 #include <sstream>
 
+#include "rio_lib/log.h"
 #include "util.h"
 
 namespace RIO {
@@ -87,10 +88,9 @@ bool Data::HasNextFrame() const {
 }
 
 bool Data::LoadIntrinsics() {
-    std::cout << data_path_ << "/" << data_config_.calib_file_ << std::endl;
     std::string line{""};
     const std::string calib_file = data_path_ + "/" + data_config_.calib_file_;
-    std::cout << calib_file << std::endl;
+    RIO_LOG(Info) << "loading " << calib_file;
     std::ifstream file(calib_file);
     if (file.is_open()) {
         while (std::getline(file,line)) {
@@ -0,0 +1,89 @@
+/*******************************************************
+* Copyright (c) 2020, Johanna Wald
+* All rights reserved.
+*
+* This file is distributed under the GNU Lesser General Public License v3.0.
+* The complete license agreement can be obtained at:
+* http://www.gnu.org/licenses/lgpl-3.0.html
+********************************************************/
+
+#include "frame_writer.h"
+
+#include <cerrno>
+#include <fstream>
+#include <system_error>
+
+#include <opencv2/opencv.hpp>
+
+#include "rio_lib/log.h"
+
+namespace RIO {
+
+FrameWriter::FrameWriter(const unsigned num_threads, const size_t capacity):
+    capacity_((capacity > 0) ? capacity : 2 * ((num_threads > 0) ? num_threads : DefaultThreads())),
+    pool_(num_threads) {
+}
+
+FrameWriter::~FrameWriter() {
+    try {
+        Wait();
+    } catch (const std::exception& e) {
+        RIO_LOG(Error) << e.what();
+    }
+}
+
+void FrameWriter::WriteImage(const std::string& filename, const cv::Mat& image) {
+    Submit([filename, image]() {
+        if (!cv::imwrite(filename, image))
+            throw std::system_error(errno, std::system_category(), "failed to write " + filename);
+    });
+}
+
+void FrameWriter::WriteText(const std::string& filename, const std::string& text) {
+    Submit([filename, text]() {
+        std::ofstream outfile(filename);
+        outfile << text;
+        outfile.close();
+        if (outfile.fail())
+            throw std::system_error(errno, std::system_category(), "failed to write " + filename);
+    });
+}
+
+void FrameWriter::Submit(std::function<void()> write) {
+    {
+        // Backpressure: the render thread waits here while the writers are behind.
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return in_flight_ < capacity_ || error_; });
+        Rethrow();
+        in_flight_++;
+    }
+    pool_.Submit([this, write]() {
+        std::exception_ptr error;
+        try {
+            write();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error && !error_)
+            error_ = error;
+        in_flight_--;
+        done_.notify_all();
+    });
+}
+
+void FrameWriter::Wait() {
+    pool_.Wait();
+    std::lock_guard<std::mutex> lock(mutex_);
+    Rethrow();
+}
+
+void FrameWriter::Rethrow() {
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+}; // namespace RIO
@@ -0,0 +1,85 @@
+/*******************************************************
+* Copyright (c) 2020, Johanna Wald
+* All rights reserved.
+*
+* This file is distributed under the GNU Lesser General Public License v3.0.
+* The complete license agreement can be obtained at:
+* http://www.gnu.org/licenses/lgpl-3.0.html
+********************************************************/
+
+#include "framebuffer.h"
+
+#include "rio_lib/log.h"
+
+namespace RIO {
+
+Framebuffer::Framebuffer(const int width, const int height): width_(width), height_(height) {
+    glGenFramebuffers(1, &framebuffer_);
+}
+
+Framebuffer::~Framebuffer() {
+    if (!renderbuffers_.empty())
+        glDeleteRenderbuffers(renderbuffers_.size(), renderbuffers_.data());
+    glDeleteFramebuffers(1, &framebuffer_);
+}
+
+GLuint Framebuffer::AddRenderbuffer(const GLenum internal_format, const GLenum attachment) {
+    GLuint renderbuffer = 0;
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, internal_format, width_, height_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    renderbuffers_.push_back(renderbuffer);
+    return renderbuffer;
+}
+
+int Framebuffer::AddColor(const GLenum internal_format) {
+    const int index = static_cast<int>(draw_buffers_.size());
+    AddRenderbuffer(internal_format, GL_COLOR_ATTACHMENT0 + index);
+    draw_buffers_.push_back(GL_COLOR_ATTACHMENT0 + index);
+    integer_.push_back(internal_format == GL_R8UI || internal_format == GL_R16UI || internal_format == GL_R32UI ||
+                       internal_format == GL_R8I || internal_format == GL_R16I || internal_format == GL_R32I);
+    return index;
+}
+
+void Framebuffer::AddDepth(const GLenum internal_format) {
+    AddRenderbuffer(internal_format, GL_DEPTH_ATTACHMENT);
+}
+
+bool Framebuffer::Complete() {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glDrawBuffers(draw_buffers_.size(), draw_buffers_.data());
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        RIO_LOG(Error) << "FRAMEBUFFER:: incomplete (0x" << std::hex << status << ")";
+        return false;
+    }
+    return true;
+}
+
+void Framebuffer::Clear(const float red, const float green, const float blue, const float alpha) const {
+    // glClear is undefined for integer attachments, so each one is cleared on its own.
+    const GLfloat color[] = { red, green, blue, alpha };
+    const GLuint zero[] = { 0, 0, 0, 0 };
+    for (size_t i = 0; i < draw_buffers_.size(); i++) {
+        if (integer_[i])
+            glClearBufferuiv(GL_COLOR, i, zero);
+        else
+            glClearBufferfv(GL_COLOR, i, color);
+    }
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void Framebuffer::Bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glViewport(0, 0, width_, height_);
+}
+
+void Framebuffer::ReadFrom(const int attachment) const {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+    glReadBuffer(GL_COLOR_ATTACHMENT0 + attachment);
+}
+
+}; // namespace RIO
@@ -20,13 +20,18 @@ int main (int argc, char* argv[]) {
     const std::string output_folder{argv[3]}; 
     const std::string seq_path = data_path + "/" + scan_id + "/sequence/";
     const std::string output_path = data_path + "/" + scan_id + "/" + output_folder + "/";
+    // optional: window or headless (default: RIO_RENDER_BACKEND or window)
+    RIO::RenderBackend backend = RIO::DefaultRenderBackend();
+    if (argc > 4 && !RIO::ParseRenderBackend(argv[4], backend))
+        return 0;
     RIO::Renderer renderer(seq_path, data_path, scan_id);
-    renderer.Init();
+    if (renderer.Init(backend) != 0)
+        return 1;
     renderer.Render(28, output_path);
     // let's visualize the bounding boxes
     cv::Mat bb_image;
     renderer.GetColor().copyTo(bb_image);
-    if (!bb_image.empty()) {
+    if (!bb_image.empty() && backend == RIO::RenderBackend::Window) {
         cv::rotate(bb_image, bb_image, cv::ROTATE_90_COUNTERCLOCKWISE);
         const std::map<int, Eigen::Vector4i>& bboxes = renderer.Get2DBoundingBoxes();
         const std::map<int, std::string>& id2label = renderer.GetInstance2Label();
@@ -0,0 +1,79 @@
+/*******************************************************
+* Copyright (c) 2020, Johanna Wald
+* All rights reserved.
+*
+* This file is distributed under the GNU Lesser General Public License v3.0.
+* The complete license agreement can be obtained at:
+* http://www.gnu.org/licenses/lgpl-3.0.html
+********************************************************/
+
+#include "readback.h"
+
+#include "rio_lib/log.h"
+
+namespace RIO {
+
+ReadbackRing::ReadbackRing(const int slots, const std::vector<size_t>& sizes):
+    sizes_(sizes), buffers_(slots * sizes.size(), 0), fences_(slots, nullptr) {
+    glGenBuffers(buffers_.size(), buffers_.data());
+    for (int slot = 0; slot < slots; slot++) {
+        for (size_t image = 0; image < sizes_.size(); image++) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer(slot, image));
+            glBufferData(GL_PIXEL_PACK_BUFFER, sizes_[image], nullptr, GL_STREAM_READ);
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+ReadbackRing::~ReadbackRing() {
+    for (const GLsync fence: fences_) {
+        if (fence != nullptr)
+            glDeleteSync(fence);
+    }
+    glDeleteBuffers(buffers_.size(), buffers_.data());
+}
+
+void ReadbackRing::Read(const int slot, const int image, const int width, const int height,
+                        const GLenum format, const GLenum type) {
+    // The pack buffer is only bound while reading, glReadPixels into client memory
+    // (e.g. in Renderer::ReadRGB) keeps working.
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer(slot, image));
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, format, type, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void ReadbackRing::Fence(const int slot) {
+    if (fences_[slot] != nullptr)
+        glDeleteSync(fences_[slot]);
+    fences_[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void ReadbackRing::Wait(const int slot) {
+    if (fences_[slot] == nullptr)
+        return;
+    GLenum status = GL_TIMEOUT_EXPIRED;
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(fences_[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    if (status == GL_WAIT_FAILED)
+        RIO_LOG(Error) << "READBACK:: waiting for slot " << slot << " failed";
+    glDeleteSync(fences_[slot]);
+    fences_[slot] = nullptr;
+}
+
+const void* ReadbackRing::Map(const int slot, const int image) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer(slot, image));
+    const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizes_[image], GL_MAP_READ_BIT);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (data == nullptr)
+        RIO_LOG(Error) << "READBACK:: can not map image " << image << " of slot " << slot;
+    return data;
+}
+
+void ReadbackRing::Unmap(const int slot, const int image) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer(slot, image));
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+}; // namespace RIO
@@ -17,7 +17,7 @@
 int main (int argc, char* argv[]) {
     if (argc < 5)
         return 0;
-    // data_path scan_id output_folder render_mode
+    // data_path scan_id output_folder render_mode [window|headless]
     const std::string data_path{argv[1]}; 
     const std::string scan_id{argv[2]}; 
     const std::string output_folder{argv[3]}; 
@@ -26,6 +26,9 @@ int main (int argc, char* argv[]) {
     const int render_mode = atoi({argv[4]}); 
     if (render_mode > 4)
         return 0;
+    RIO::RenderBackend backend = RIO::DefaultRenderBackend();
+    if (argc > 5 && !RIO::ParseRenderBackend(argv[5], backend))
+        return 0;
 
     const std::string seq_path = data_path + "/" + scan_id + "/sequence/";
     const std::string output_path = data_path + "/" + scan_id + "/" + output_folder + "/";
@@ -36,6 +39,7 @@ int main (int argc, char* argv[]) {
     const bool save_occlusion = render_mode == 0;
     const float fov_scale = (save_occlusion ? 2.0f : 1.0f);
     RIO::Renderer renderer(seq_path, data_path, scan_id, save_images, save_depth, save_bounding_boxes, save_occlusion, fov_scale);
-    renderer.Init();
+    if (renderer.Init(backend) != 0)
+        return 1;
     renderer.RenderAllFrames(output_path);
 }
@@ -0,0 +1,161 @@
+/*******************************************************
+* Copyright (c) 2020, Johanna Wald
+* All rights reserved.
+*
+* This file is distributed under the GNU Lesser General Public License v3.0.
+* The complete license agreement can be obtained at:
+* http://www.gnu.org/licenses/lgpl-3.0.html
+********************************************************/
+
+#include "render_context.h"
+
+#include <cstdlib>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#ifdef RIO_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "rio_lib/log.h"
+
+namespace RIO {
+
+namespace {
+
+// Loads the OpenGL functions of the current context.
+bool InitGLEW() {
+    glewExperimental = GL_TRUE;
+    const GLenum status = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLEW 2.0 and later built for GLX reports a missing X display for EGL
+    // contexts, the function pointers are loaded nevertheless.
+    if (status == GLEW_ERROR_NO_GLX_DISPLAY)
+        return true;
+#endif
+    if (status != GLEW_OK) {
+        RIO_LOG(Error) << "GLEW:: " << glewGetErrorString(status);
+        return false;
+    }
+    return true;
+}
+
+class WindowContext: public RenderContext {
+public:
+    ~WindowContext() {
+        if (window_ != nullptr)
+            glfwDestroyWindow(window_);
+        glfwTerminate();
+    }
+    bool Init(const int width, const int height) {
+        if (!glfwInit())
+            return false;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+        // Create a GLFWwindow object that we can use for GLFW's functions
+        window_ = glfwCreateWindow(width, height, "Evaluation", nullptr, nullptr);
+        if (window_ == nullptr)
+            return false;
+        glfwMakeContextCurrent(window_);
+        return InitGLEW();
+    }
+private:
+    GLFWwindow* window_{nullptr};
+};
+
+#ifdef RIO_HAS_EGL
+class HeadlessContext: public RenderContext {
+public:
+    ~HeadlessContext() {
+        if (display_ == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context_ != EGL_NO_CONTEXT)
+            eglDestroyContext(display_, context_);
+        eglTerminate(display_);
+    }
+    bool Init() {
+        // Prefer the surfaceless platform of Mesa, it needs neither X11 nor a DRM device.
+        const PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+        if (get_platform_display != nullptr)
+            display_ = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+#endif
+        if (display_ == EGL_NO_DISPLAY)
+            display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        EGLint major = 0, minor = 0;
+        if (display_ == EGL_NO_DISPLAY || !eglInitialize(display_, &major, &minor)) {
+            RIO_LOG(Error) << "EGL:: no display";
+            display_ = EGL_NO_DISPLAY;
+            return false;
+        }
+        const EGLint config_attributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                                             EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLConfig config = nullptr;
+        EGLint num_configs = 0;
+        eglChooseConfig(display_, config_attributes, &config, 1, &num_configs);
+        const EGLint context_attributes[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                                              EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                              EGL_NONE };
+        // Without a surface the config only selects the API (EGL_KHR_surfaceless_context).
+        if (!eglBindAPI(EGL_OPENGL_API) ||
+            (context_ = eglCreateContext(display_, (num_configs > 0) ? config : nullptr, EGL_NO_CONTEXT,
+                                         context_attributes)) == EGL_NO_CONTEXT ||
+            !eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_)) {
+            RIO_LOG(Error) << "EGL:: can not create a surfaceless OpenGL 3.3 context (0x"
+                           << std::hex << eglGetError() << ")";
+            return false;
+        }
+        RIO_LOG(Info) << "EGL " << major << "." << minor << ", " << glGetString(GL_RENDERER);
+        return InitGLEW();
+    }
+private:
+    EGLDisplay display_{EGL_NO_DISPLAY};
+    EGLContext context_{EGL_NO_CONTEXT};
+};
+#endif
+
+}  // namespace
+
+bool ParseRenderBackend(const std::string& name, RenderBackend& backend) {
+    if (name == "window")
+        backend = RenderBackend::Window;
+    else if (name == "headless")
+        backend = RenderBackend::Headless;
+    else
+        return false;
+    return true;
+}
+
+RenderBackend DefaultRenderBackend() {
+    RenderBackend backend = RenderBackend::Window;
+    const char* name = std::getenv("RIO_RENDER_BACKEND");
+    if (name != nullptr && !ParseRenderBackend(name, backend))
+        RIO_LOG(Warning) << "unknown RIO_RENDER_BACKEND " << name;
+    return backend;
+}
+
+std::unique_ptr<RenderContext> RenderContext::Create(const RenderBackend backend, const int width, const int height) {
+    if (backend == RenderBackend::Headless) {
+#ifdef RIO_HAS_EGL
+        std::unique_ptr<HeadlessContext> context(new HeadlessContext());
+        if (context->Init())
+            return std::move(context);
+#else
+        RIO_LOG(Error) << "rio_renderer was built without EGL, no headless rendering";
+#endif
+        return nullptr;
+    }
+    std::unique_ptr<WindowContext> context(new WindowContext());
+    if (context->Init(width, height))
+        return std::move(context);
+    return nullptr;
+}
+
+}; // namespace RIO
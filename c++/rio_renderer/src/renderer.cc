@@ -1,11 +1,82 @@
 #include "renderer.h"
 
+#include <chrono>
+#include <cstring>
+
+#include "frame_writer.h"
 #include "json11.hpp"
 #include "model.h"
+#include "readback.h"
+#include "rio_lib/log.h"
 #include "util.h"
 
 namespace RIO {
 
+namespace {
+
+// Number of frames in flight in RenderAllFrames: while frame N is drawn, frame N - 1
+// is transferred and frame N - 2 is converted and saved.
+constexpr int kReadbackSlots{3};
+
+// Color attachments of the framebuffer, the outputs of the fragment shaders.
+enum Attachment { kColorAttachment = 0, kInstanceAttachment, kDepthAttachment, kLabelAttachment };
+
+// Images of a frame in the readback ring.
+enum ReadbackImage { kLabels = 0, kInstances, kColor, kDepth };
+
+// Accumulated time of the stages of RenderAllFrames. The GPU work and the transfers
+// run in the background of the other stages, Wait is the part that did not overlap.
+class StageTimes {
+public:
+    enum Stage { Draw = 0, Read, Wait, Convert, Save, kStages };
+    StageTimes(): last_(std::chrono::steady_clock::now()) { }
+    // Adds the time since the last lap to stage.
+    void Lap(const Stage stage) {
+        const auto now = std::chrono::steady_clock::now();
+        seconds_[stage] += std::chrono::duration<double>(now - last_).count();
+        last_ = now;
+    }
+    void Report(const int frames) const {
+        const char* names[kStages] = { "draw", "read", "wait", "convert", "save" };
+        double total = 0;
+        std::stringstream stages;
+        for (int stage = 0; stage < kStages; stage++) {
+            total += seconds_[stage];
+            stages << " " << names[stage] << " " << 1000 * seconds_[stage] / std::max(frames, 1) << " ms";
+        }
+        RIO_LOG(Info) << "rendered " << frames << " frames in " << total << " s, per frame:" << stages.str();
+    }
+private:
+    std::chrono::steady_clock::time_point last_;
+    double seconds_[kStages] = { 0, 0, 0, 0, 0 };
+};
+
+const std::string FramePrefix(const std::string& save_path, const int frame_id) {
+    std::stringstream filename;
+    filename << save_path << "/frame-" << std::setfill('0') << std::setw(6) << frame_id;
+    return filename.str();
+}
+
+// Adds the pixels of every instance id within rect of the instance image to counts.
+void InstanceHistogram(const cv::Mat& instances, const cv::Rect& rect, std::vector<unsigned>& counts) {
+    for (int row = rect.y; row < rect.y + rect.height; row++) {
+        const unsigned short* ids = instances.ptr<unsigned short>(row);
+        for (int col = rect.x; col < rect.x + rect.width; col++) {
+            if (ids[col] >= counts.size())
+                counts.resize(ids[col] + 1, 0);
+            counts[ids[col]]++;
+        }
+    }
+}
+
+// Copies a mapped readback buffer into a new image (the writer may still hold the last one).
+void CopyImage(const void* data, const int rows, const int cols, const int type, cv::Mat& image) {
+    image = cv::Mat(rows, cols, type);
+    std::memcpy(image.data, data, image.total() * image.elemSize());
+}
+
+} // namespace
+
 Renderer::Renderer(const std::string& sequence_path, 
                    const std::string& data_path, 
                    const std::string& scan_id,
@@ -23,11 +94,12 @@ Renderer::Renderer(const std::string& sequence_path,
 }
 
 Renderer::~Renderer() {
+    if (!occlusion_queries_.empty())
+        glDeleteQueries(occlusion_queries_.size(), occlusion_queries_.data());
     delete shader_labels_;
     delete shader_RGB_;
     delete model_labels_;
     delete model_RGB_;
-    glfwTerminate();
 }
 
 const std::map<int, Eigen::Vector4i>& Renderer::Get2DBoundingBoxes() const {
@@ -54,20 +126,29 @@ const cv::Mat& Renderer::GetDepth() const {
     return rio_data_.depth;
 }
 
-int Renderer::Init() {
-    if (!(glfwInit() && data_.LoadIntrinsics() && data_fov_scale_.LoadIntrinsics()))
+int Renderer::Init(const RenderBackend backend) {
+    if (!(data_.LoadIntrinsics() && data_fov_scale_.LoadIntrinsics()))
         return -1; 
 
-    InitGLFW();
-    // Create a GLFWwindow object that we can use for GLFW's functions
-    window = glfwCreateWindow(data_.intrinsics.width, data_.intrinsics.height, "Evaluation", nullptr, nullptr);
-    if (nullptr == window) {
-        glfwTerminate();
+    context_ = RenderContext::Create(backend, data_.intrinsics.width, data_.intrinsics.height);
+    if (!context_)
         return EXIT_FAILURE;
-    }
-    glfwMakeContextCurrent(window);
-    glewExperimental = GL_TRUE;
-    if (GLEW_OK != glewInit())
+    // All images are rendered into a framebuffer of exactly the image size, the
+    // size of a window framebuffer may differ (e.g. on retina displays). The images
+    // are stored rotated by 90 degrees, the projection swaps x and y (see Projection())
+    // so glReadPixels returns them in that orientation.
+    buffer_width = data_.intrinsics.height;
+    buffer_height = data_.intrinsics.width;
+    framebuffer_.reset(new Framebuffer(buffer_width, buffer_height));
+    // The textured shader writes the color, both shaders write the instance id, the
+    // linear depth in mm (0 where nothing is rendered) and the label color of every pixel.
+    framebuffer_->AddColor(GL_RGBA8);
+    framebuffer_->AddColor(GL_R16UI);
+    framebuffer_->AddColor(GL_R16UI);
+    framebuffer_->AddColor(GL_RGBA8);
+    framebuffer_->AddDepth();
+    writer_.reset(new FrameWriter());
+    if (!framebuffer_->Complete())
         return EXIT_FAILURE;
     glEnable(GL_DEPTH_TEST);
     
@@ -77,34 +158,17 @@ int Renderer::Init() {
 
     // load models with all objects in it
     const std::string file_prefix = v2_ ? ".v2" : "";
-    model_labels_ = new Model(data_path_ + "/" + rio_data_.scan_id + "/labels.instances.annotated" + file_prefix + ".ply");
+    const std::string labels_file = data_path_ + "/" + rio_data_.scan_id + "/labels.instances.annotated" + file_prefix + ".ply";
     if (save_depth_ || save_images_ || save_bounding_boxes_) {
-        model_RGB_ = new Model(data_path_ + "/" + rio_data_.scan_id + "/mesh.refined" + file_prefix + ".obj");
-    }
-
-    // load models with just one instance visible
-    if (save_occlusion_) {
-        LoadObjects(data_path_ + "/objects.json"); // load this now because we need it now (otherwise it is loaded in first render call)
-        for (const auto& i2c: rio_data_.instance2color) {
-            const int instance_id = i2c.first;
-            const unsigned long color = i2c.second; // this is the RGB hex value stored in an ulong
-            
-            // extract RGB color values
-            const int r = ((color >> 16) & 0xFF);  // Extract the RR byte
-            const int g = ((color >> 8) & 0xFF);   // Extract the GG byte
-            const int b = ((color) & 0xFF);        // Extract the BB byte
-
-            // create model with only the current instance visible
-            glm::vec3 rgb(r / 255.0f, g / 255.0f, b / 255.0f); // required to be in [0..1] scale because this is how the colors are defined in the mesh file
-            Model* model_label_one_instance_only = new Model(data_path_ + "/" + rio_data_.scan_id + "/labels.instances.annotated" + file_prefix + ".ply", rgb);
-            instance2model_with_instance_only_[instance_id] = model_label_one_instance_only;
-        }
+        // the textured mesh carries the colors and objectIds of the labels as well,
+        // one draw renders all images (the labels model is only loaded as fallback)
+        model_RGB_ = new Model(data_path_ + "/" + rio_data_.scan_id + "/mesh.refined" + file_prefix + ".obj", labels_file);
     }
+    if (model_RGB_ == nullptr || !model_RGB_->labeled())
+        model_labels_ = new Model(labels_file);
 
     data_.LoadViewMatrix();
     initalized_ = true;
-    // We have to read the buffer size because of retrina displays. 
-    glfwGetFramebufferSize(window, &buffer_width, &buffer_height);
     return 0;
 }
 
@@ -116,62 +180,51 @@ void Renderer::Render(const int frame_id, const std::string save_path) {
 void Renderer::Render(const bool inc_frame_id, const std::string save_path) {
     if (!initalized_)
         return;
-    
-    GLuint framebuffername = 1;
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffername);
+    RenderFrame(inc_frame_id, save_path);
+    writer_->Wait();
+}
+
+void Renderer::RenderFrame(const bool inc_frame_id, const std::string& save_path) {
+    framebuffer_->Bind();
 
     // the default projection matrix (without scaled fov value)
-    projection_ = camera_utils::perspective<Eigen::Matrix4f::Scalar>(data_.intrinsics, kNearPlane, kFarPlane);    
+    projection_ = Projection(data_.intrinsics);
 
     // this is needed for both saving cases so always render it
-    DrawScene(*model_labels_, *shader_labels_);
+    DrawLabels();
     ReadLabels(rio_data_.labels, rio_data_.instances);
     if (save_path != "" && (save_depth_ || save_images_ || save_bounding_boxes_ || save_occlusion_)) {
-        std::stringstream filename;
-        filename << save_path << "/frame-" << std::setfill('0') << std::setw(6) << data_.frame_id();
+        const std::string filename = FramePrefix(save_path, data_.frame_id());
 
         // render + save rendered color, depth, label, instance images and the bbox file.
         if (save_depth_ || save_images_ || save_bounding_boxes_) {
-            // only now are the rgb and depth images needed
-            DrawScene(*model_RGB_, *shader_RGB_);
+            // only now are the rgb and depth images needed (already drawn with the labels of a labeled mesh)
+            if (model_labels_ != nullptr)
+                DrawScene(*model_RGB_, *shader_RGB_);
             ReadRGB(rio_data_.color);
             ReadDepth(rio_data_.depth);
-            if (save_depth_) {
-                if (!cv::imwrite(filename.str() + ".rendered.depth.png", rio_data_.depth))
-                    throw std::system_error(errno, std::system_category(), "failed to write " + save_path);
-            }
-            if (save_images_) {
-                if (!cv::imwrite(filename.str() + ".rendered.color.jpg", rio_data_.color) |
-                    !cv::imwrite(filename.str() + ".rendered.labels.png", rio_data_.labels) |
-                    !cv::imwrite(filename.str() + ".rendered.instances.png", rio_data_.instances))
-                    throw std::system_error(errno, std::system_category(), "failed to write " + save_path);
-            }
-            if (save_bounding_boxes_) {
-                std::ofstream outfile(filename.str() + ".bb.txt");
-                for (const auto& bb: rio_data_.bboxes) {
-                    const Eigen::Vector4i& box = bb.second;
-                    if (rio_data_.instance2label.find(bb.first) != rio_data_.instance2label.end()) 
-                        outfile << bb.first << " " << box(0) << " " << box(1) << " " << box(2) << " " << box(3) << std::endl;
-                }
-                outfile.close();
-            }
+            SaveFrame(filename);
         }
 
         // render + save the occlusion score for each object instance id
         if (save_occlusion_) {
+            // only the instances visible in this frame get scores, the set of the last
+            // frame is replaced by the one of the instance image
+            VisibleInstances(rio_data_.instances, visible_instances_);
+
             // use original intrinsics for calculating occlusion
-            CalcOcclusions(rio_data_.instance2color, rio_data_.instances2occlusion, rio_data_.labels);
+            CalcOcclusions(visible_instances_, rio_data_.instances2occlusion);
 
             // use fov scaled intrinsics for calcuating truncation
-            projection_ = camera_utils::perspective<Eigen::Matrix4f::Scalar>(data_fov_scale_.intrinsics, kNearPlane, kFarPlane);
-            DrawScene(*model_labels_, *shader_labels_);
+            projection_ = Projection(data_fov_scale_.intrinsics);
+            DrawLabels();
             ReadLabels(rio_data_.labels_fov_scale, rio_data_.instances);
-            CalcTruncations(rio_data_.instance2color, rio_data_.instances2truncation, rio_data_.labels_fov_scale);
+            CalcTruncations(visible_instances_, rio_data_.instances2truncation, rio_data_.instances);
 
             // verify calculations
             VerifyTruncationAndOcclusion(rio_data_.instances2occlusion, rio_data_.instances2truncation);
 
-            std::ofstream outfile(filename.str() + ".visibility.txt");
+            std::stringstream outfile;
             for (const auto& instance2occlusion : rio_data_.instances2occlusion) {
                 int instance_id = instance2occlusion.first;
                 Renderer::VisibilityEntry occlusion = instance2occlusion.second;
@@ -180,7 +233,7 @@ void Renderer::Render(const bool inc_frame_id, const std::string save_path) {
                 if (rio_data_.instance2label.find(instance_id) != rio_data_.instance2label.end())
                     outfile << instance_id << " " << truncation.original_pixel_count << " " << truncation.complete_pixel_count << " " << truncation.ratio << " " << occlusion.original_pixel_count << " " << occlusion.complete_pixel_count << " " << occlusion.ratio << std::endl;
             }
-            outfile.close();
+            writer_->WriteText(filename + ".visibility.txt", outfile.str());
         }
         
     }
@@ -188,9 +241,45 @@ void Renderer::Render(const bool inc_frame_id, const std::string save_path) {
         data_.NextFrame();
 }
 
+void Renderer::SaveFrame(const std::string& filename) {
+    // The writer keeps the images, the next frame is read into newly allocated ones.
+    if (save_depth_)
+        writer_->WriteImage(filename + ".rendered.depth.png", rio_data_.depth);
+    if (save_images_) {
+        writer_->WriteImage(filename + ".rendered.color.jpg", rio_data_.color);
+        writer_->WriteImage(filename + ".rendered.labels.png", rio_data_.labels);
+        writer_->WriteImage(filename + ".rendered.instances.png", rio_data_.instances);
+    }
+    if (save_bounding_boxes_) {
+        std::stringstream outfile;
+        for (const auto& bb: rio_data_.bboxes) {
+            const Eigen::Vector4i& box = bb.second;
+            if (rio_data_.instance2label.find(bb.first) != rio_data_.instance2label.end()) 
+                outfile << bb.first << " " << box(0) << " " << box(1) << " " << box(2) << " " << box(3) << std::endl;
+        }
+        writer_->WriteText(filename + ".bb.txt", outfile.str());
+    }
+}
+
+Eigen::Matrix4f Renderer::Projection(const Intrinsics& intrinsics) const {
+    // glReadPixels returns the rows bottom up, the images are stored top down and rotated
+    // by 90 degrees clockwise. Both together map the pixel (x, y) of the OpenGL image to
+    // (row x, column y), i.e. they transpose it. Swapping x and y of the clip coordinates
+    // renders the transposed image directly (into a framebuffer of size height x width).
+    Eigen::Matrix4f transpose{Eigen::Matrix4f::Identity()};
+    transpose.topLeftCorner<2,2>() << 0, 1, 1, 0;
+    return transpose * camera_utils::perspective<Eigen::Matrix4f::Scalar>(intrinsics, kNearPlane, kFarPlane);
+}
+
+void Renderer::DrawLabels() {
+    if (model_labels_ != nullptr)
+        DrawScene(*model_labels_, *shader_labels_);
+    else
+        DrawScene(*model_RGB_, *shader_RGB_);
+}
+
 void Renderer::DrawScene(Model& model, Shader& shader) {
-    glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    framebuffer_->Clear(0.05f, 0.05f, 0.05f, 1.0f);
     Render(model, shader);
 }
 
@@ -202,21 +291,13 @@ void Renderer::Render(Model& model, Shader& shader) {
     model.Draw(shader);
 }
 
-void Renderer::InitGLFW() {
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-}
-
 bool Renderer::LoadObjects(const std::string& obj_file) {
     std::ifstream is(obj_file);
     std::string dataset((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
     std::string err;
     const auto json = json11::Json::parse(dataset, err);
     if (err != "") {
-        std::cout << "didn't find objects.json in " << data_path_ << std::endl;
+        RIO_LOG(Error) << "didn't find objects.json in " << data_path_;
         return false;
     }
     // Iterates through all the scans.
@@ -241,119 +322,106 @@ bool Renderer::LoadObjects(const std::string& obj_file) {
 
 void Renderer::ReadLabels(cv::Mat& image, cv::Mat& instances) {
     if (!rio_data_.color2instances.empty() || LoadObjects(data_path_ + "/objects.json")) {
-        glBindFramebuffer(GL_FRAMEBUFFER, 4);
+        framebuffer_->ReadFrom(kLabelAttachment);
         image = cv::Mat(buffer_height, buffer_width, CV_8UC3);
-        std::vector<float> data_buff(buffer_width * buffer_height * 3);
         glPixelStorei(GL_PACK_ALIGNMENT, 1);
-        glReadPixels(0, 0, buffer_width, buffer_height, GL_RGB, GL_FLOAT, data_buff.data());
-        for (int i = 0; i < buffer_height; ++i) {
-            for (int j = 0; j < buffer_width; ++j) {
-                for (int c = 0; c < 3; c++) {
-                    image.at<cv::Vec3b>(buffer_height - i - 1, j)[2 - c] = 
-                        static_cast<int>(255 * data_buff[int(3 * i * buffer_width + 3 * j + c)]);
-                }
-            }
-        }
+        glReadPixels(0, 0, buffer_width, buffer_height, GL_BGR, GL_UNSIGNED_BYTE, image.data);
+        // The instance ids are rendered into an integer attachment, no color lookups needed.
+        framebuffer_->ReadFrom(kInstanceAttachment);
         instances = cv::Mat(buffer_height, buffer_width, CV_16UC1);
-        for (int i = 0; i < buffer_width; i++) {
-            for (int j = 0; j < buffer_height; j++) {
-                const cv::Vec3b& vec = image.at<cv::Vec3b>(j, i);
-                const unsigned long color_hex = color_utils::RGB2Hex(vec(2), vec(1), vec(0));
-                if (rio_data_.color2instances.find(color_hex) != rio_data_.color2instances.end()) {
-                    const unsigned short Id = rio_data_.color2instances[color_hex]; // instance ID
-                    // Also intialize set list of bounding boxes.
-                    if (rio_data_.bboxes.find(Id) == rio_data_.bboxes.end())
-                        rio_data_.bboxes[Id] = Eigen::Vector4i(i, j, i, j);
-                    else {
-                        rio_data_.bboxes[Id](0) = std::min(i, rio_data_.bboxes[Id](0));
-                        rio_data_.bboxes[Id](1) = std::min(j, rio_data_.bboxes[Id](1));
-                        rio_data_.bboxes[Id](2) = std::max({i, rio_data_.bboxes[Id](2), rio_data_.bboxes[Id](0)});
-                        rio_data_.bboxes[Id](3) = std::max({j, rio_data_.bboxes[Id](3), rio_data_.bboxes[Id](1)});
-                    }
-                    instances.at<unsigned short>(j, i) = Id;
-                } else instances.at<unsigned short>(j, i) = 0;
-            }
+        glReadPixels(0, 0, buffer_width, buffer_height, GL_RED_INTEGER, GL_UNSIGNED_SHORT, instances.data);
+        UpdateBoundingBoxes(instances);
+    }
+}
+
+void Renderer::UpdateBoundingBoxes(const cv::Mat& instances) {
+    // Bounding boxes of the instances, merged with the boxes found so far. The boxes
+    // (x0, y0, x1, y1) are given in the camera image, i.e. before the rotation:
+    // pixel (row, col) of the rotated image is x = row, y = buffer_width - 1 - col.
+    std::vector<Eigen::Vector4i> boxes;
+    for (int row = 0; row < buffer_height; row++) {
+        const unsigned short* ids = instances.ptr<unsigned short>(row);
+        for (int col = 0; col < buffer_width; col++) {
+            const unsigned short Id = ids[col];
+            if (Id == 0)
+                continue;
+            if (Id >= boxes.size())
+                boxes.resize(Id + 1, Eigen::Vector4i(buffer_height, buffer_width, -1, -1));
+            const int i = row;
+            const int j = buffer_width - 1 - col;
+            Eigen::Vector4i& box = boxes[Id];
+            box(0) = std::min(i, box(0));
+            box(1) = std::min(j, box(1));
+            box(2) = std::max(i, box(2));
+            box(3) = std::max(j, box(3));
+        }
+    }
+    for (size_t Id = 0; Id < boxes.size(); Id++) {
+        if (boxes[Id](2) < 0)
+            continue;
+        const auto bbox = rio_data_.bboxes.find(Id);
+        if (bbox == rio_data_.bboxes.end()) {
+            rio_data_.bboxes[Id] = boxes[Id];
+        } else {
+            bbox->second.head<2>() = bbox->second.head<2>().cwiseMin(boxes[Id].head<2>());
+            bbox->second.tail<2>() = bbox->second.tail<2>().cwiseMax(boxes[Id].tail<2>());
         }
-        cv::rotate(image, image, cv::ROTATE_90_CLOCKWISE);
-        cv::rotate(instances, instances, cv::ROTATE_90_CLOCKWISE);
     }
 }
 
 void Renderer::ReadRGB(cv::Mat& image) {
-    glBindFramebuffer(GL_FRAMEBUFFER, 4);
+    framebuffer_->ReadFrom(kColorAttachment);
     image = cv::Mat(buffer_height, buffer_width, CV_8UC3);
-    std::vector<float> data_buff(buffer_width * buffer_height * 3);
     glPixelStorei(GL_PACK_ALIGNMENT, 1);
-    glReadPixels(0, 0, buffer_width, buffer_height, GL_RGB, GL_FLOAT, data_buff.data());
-    for (int i = 0; i < buffer_height; ++i) {
-        for (int j = 0; j < buffer_width; ++j) {
-            for (int c = 0; c < 3; c++) {
-                image.at<cv::Vec3b>(buffer_height - i - 1, j)[2 - c] = 
-                    static_cast<int>(255 * data_buff[int(3 * i * buffer_width + 3 * j + c)]);
-            }
-        }
-    }
-    cv::rotate(image, image, cv::ROTATE_90_CLOCKWISE);
+    glReadPixels(0, 0, buffer_width, buffer_height, GL_BGR, GL_UNSIGNED_BYTE, image.data);
 }
 
 void Renderer::ReadDepth(cv::Mat& image) {
+    framebuffer_->ReadFrom(kDepthAttachment);
     image = cv::Mat(buffer_height, buffer_width, CV_16UC1);
-    std::vector<float> data_buff(buffer_height * buffer_width);
     glPixelStorei(GL_PACK_ALIGNMENT, 1);
-    glReadPixels(0, 0, buffer_width, buffer_height, GL_DEPTH_COMPONENT, GL_FLOAT, data_buff.data());
-    for (int i = 0; i < buffer_height; i++) {
-        for (int j = 0; j < buffer_width; j++) {
-            const float zn = (2 * data_buff[static_cast<int>(i * buffer_width + j)] - 1);
-            const float ze = (2 * kFarPlane * kNearPlane) / (kFarPlane + kNearPlane + zn*(kNearPlane - kFarPlane));
-            image.at<unsigned short>(buffer_height - i - 1, j) = 1000 * ze;
-        }
-    }
-    cv::rotate(image, image, cv::ROTATE_90_CLOCKWISE);
+    glReadPixels(0, 0, buffer_width, buffer_height, GL_RED_INTEGER, GL_UNSIGNED_SHORT, image.data);
 }
 
-void Renderer::CalcTruncations(std::map<int, unsigned long>& instances2color, std::map<int, Renderer::VisibilityEntry>& instances2truncation, const cv::Mat& labels_fov_scale) {
-    
-    for (const auto& instance2color: instances2color) {
-        const int instance_id = instance2color.first;
-        const unsigned long color = instance2color.second; // this is the RGB hex value stored in an ulong
-
+void Renderer::VisibleInstances(const cv::Mat& instances, std::vector<int>& visible) const {
+    // The visible set of the last frame is a hint for the size of the histogram.
+    std::vector<unsigned> counts(visible.empty() ? 0 : *std::max_element(visible.begin(), visible.end()) + 1, 0);
+    InstanceHistogram(instances, cv::Rect(0, 0, instances.cols, instances.rows), counts);
+    visible.clear();
+    for (size_t instance_id = 1; instance_id < counts.size(); instance_id++) {
         // check if the parsing worked as expected. This should only fail when something is wrong with the metadata.
-        if (rio_data_.instance2label.find(instance_id) == rio_data_.instance2label.end()) continue;
-
-        // extract RGB color values
-        const int r = ((color >> 16) & 0xFF);  // Extract the RR byte
-        const int g = ((color >> 8) & 0xFF);   // Extract the GG byte
-        const int b = ((color) & 0xFF);        // Extract the BB byte
-
-        // create rect at large image to crop small image part of it
-        const int rows = labels_fov_scale.rows;
-        const int cols = labels_fov_scale.cols;
-
-        // the original image is located at the center of the rendered image with below width/height.
-        // Its upper left corner is thus fov_scale*2-times the width/height (== center of rendered image - half of original image width/height)
-        const int x = static_cast<int>(rows / (data_fov_scale_.fov_scale()*2));
-        const int y = static_cast<int>(cols / (data_fov_scale_.fov_scale()*2));
-
-        // the original image is fov_scale-times smaller than the rendered image
-        const int width = static_cast<int>(rows / data_fov_scale_.fov_scale());
-        const int height = static_cast<int>(cols / data_fov_scale_.fov_scale());
-        cv::Rect rect(y, x, height, width);
-        cv::Mat original_image = labels_fov_scale(rect);
-
-        // create image masks that only contain the color
-        cv::Mat dst_large, dst_small;
-        cv::Scalar cv_color(b, g, r); // color must be in BGR format
-
-        cv::inRange(labels_fov_scale, cv_color, cv_color, dst_large); // creates a black-white image in dst that has white pixels that match the color, rest black
-        const int number_pixels_large = cv::countNonZero(dst_large); // counts the white pixels
-
-        cv::inRange(original_image, cv_color, cv_color, dst_small); // creates a black-white image in dst that has white pixels that match the color, rest black
-        const int number_pixels_small = cv::countNonZero(dst_small); // counts the white pixels
+        if (counts[instance_id] > 0 && rio_data_.instance2label.find(instance_id) != rio_data_.instance2label.end())
+            visible.push_back(instance_id);
+    }
+}
 
-        // instance2color map contains all instances for the scene and not all instances for this frame.
-        // Thus, some instances are not visible in the current frame or frame-enlargement. 
-        // If this is the case, we do not consider that instance to have a truncation score in this frame.
-        // Only instances that are visible will be added to the truncation list for this frame.
+void Renderer::CalcTruncations(const std::vector<int>& visible, std::map<int, Renderer::VisibilityEntry>& instances2truncation, const cv::Mat& instances_fov_scale) {
+    // create rect at large image to crop small image part of it
+    const int rows = instances_fov_scale.rows;
+    const int cols = instances_fov_scale.cols;
+
+    // the original image is located at the center of the rendered image with below width/height.
+    // Its upper left corner is thus fov_scale*2-times the width/height (== center of rendered image - half of original image width/height)
+    const int x = static_cast<int>(rows / (data_fov_scale_.fov_scale()*2));
+    const int y = static_cast<int>(cols / (data_fov_scale_.fov_scale()*2));
+
+    // the original image is fov_scale-times smaller than the rendered image
+    const int width = static_cast<int>(rows / data_fov_scale_.fov_scale());
+    const int height = static_cast<int>(cols / data_fov_scale_.fov_scale());
+    cv::Rect rect(y, x, height, width);
+
+    // pixels of every instance in the large and in the original image, one pass each
+    // instead of a mask per instance of the scene
+    std::vector<unsigned> counts_large, counts_small;
+    InstanceHistogram(instances_fov_scale, cv::Rect(0, 0, cols, rows), counts_large);
+    InstanceHistogram(instances_fov_scale, rect, counts_small);
+
+    // Only the instances visible in the frame can be truncated, all others have no
+    // truncation score in this frame.
+    for (const int instance_id: visible) {
+        const size_t id = instance_id;
+        const unsigned number_pixels_large = (id < counts_large.size()) ? counts_large[id] : 0;
+        const unsigned number_pixels_small = (id < counts_small.size()) ? counts_small[id] : 0;
         const bool valid_instance = number_pixels_large > 0 && number_pixels_small > 0; 
 
         if (valid_instance) {
@@ -361,39 +429,56 @@ void Renderer::CalcTruncations(std::map<int, unsigned long>& instances2color, st
                                                                           static_cast<float>(number_pixels_large));
         }
     }
-    
 }
 
-void Renderer::CalcOcclusions(std::map<int, unsigned long>& instances2color, std::map<int, Renderer::VisibilityEntry>& instances2occlusion, const cv::Mat& labels){
-    for (const auto& instance2color: instances2color) {
-        const int instance_id = instance2color.first;
-        const unsigned long color = instance2color.second; // this is the RGB hex value stored in an ulong
-
-        // check if the parsing worked as expected. This should only fail when something is wrong with the metadata.
-        if (rio_data_.instance2label.find(instance_id) == rio_data_.instance2label.end()) continue;
-
-        // extract RGB color values
-        const int r = ((color >> 16) & 0xFF);  // Extract the RR byte
-        const int g = ((color >> 8) & 0xFF);   // Extract the GG byte
-        const int b = ((color) & 0xFF);        // Extract the BB byte
-
-        // load model with only the current instance visible
-        Model* model_label_one_instance_only = instance2model_with_instance_only_[instance_id];
-
-        // render label image with just this instance
-        cv::Mat label_image_one_instance_only, instance_image_one_instance_only;
-        DrawScene(*model_label_one_instance_only, *shader_labels_);
-        ReadLabels(label_image_one_instance_only, instance_image_one_instance_only);
-
-        // count the pixels in the original image (with all instances rendered) and in the image with just this instance
-        cv::Mat dst_original, dst_one_instance_only;
-        cv::Scalar cv_color(b, g, r); // color must be in BGR format
+void Renderer::CalcOcclusions(const std::vector<int>& visible, std::map<int, Renderer::VisibilityEntry>& instances2occlusion){
+    if (visible.empty())
+        return;
+    if (occlusion_queries_.size() < 2 * visible.size()) {
+        const size_t begin = occlusion_queries_.size();
+        occlusion_queries_.resize(2 * visible.size());
+        glGenQueries(occlusion_queries_.size() - begin, &occlusion_queries_[begin]);
+    }
 
-        cv::inRange(labels, cv_color, cv_color, dst_original); // creates a black-white image in dst that has white pixels that match the color, rest black
-        const int number_pixels_original = cv::countNonZero(dst_original); // counts the white pixels
+    // Only depth tests and sample counts are needed, no color is written.
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    // depth pre-pass of the whole scene with the same geometry and shader as the instances
+    // (Render leaves the shader in use for the instance ranges below)
+    Model& scene = (model_labels_ != nullptr) ? *model_labels_ : *model_RGB_;
+    glClear(GL_DEPTH_BUFFER_BIT);
+    Render(scene, *shader_labels_);
+    // the samples of an instance that are not behind the scene are its visible pixels
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_LEQUAL);
+    for (size_t i = 0; i < visible.size(); i++) {
+        glBeginQuery(GL_SAMPLES_PASSED, occlusion_queries_[2 * i]);
+        scene.DrawInstance(visible[i]);
+        glEndQuery(GL_SAMPLES_PASSED);
+    }
+    // the samples of an instance that are not behind itself are the pixels it would cover
+    // without occluders. Drawing without depth test would count its hidden parts as well,
+    // so its own depth is drawn first.
+    for (size_t i = 0; i < visible.size(); i++) {
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        scene.DrawInstance(visible[i]);
+        glDepthMask(GL_FALSE);
+        glDepthFunc(GL_LEQUAL);
+        glBeginQuery(GL_SAMPLES_PASSED, occlusion_queries_[2 * i + 1]);
+        scene.DrawInstance(visible[i]);
+        glEndQuery(GL_SAMPLES_PASSED);
+    }
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
 
-        cv::inRange(label_image_one_instance_only, cv_color, cv_color, dst_one_instance_only); // creates a black-white image in dst that has white pixels that match the color, rest black
-        const int number_pixels_one_instance_only = cv::countNonZero(dst_one_instance_only); // counts the white pixels
+    // Only the sample counts are read back, once all queries are issued.
+    for (size_t i = 0; i < visible.size(); i++) {
+        GLuint number_pixels_original = 0;
+        GLuint number_pixels_one_instance_only = 0;
+        glGetQueryObjectuiv(occlusion_queries_[2 * i], GL_QUERY_RESULT, &number_pixels_original);
+        glGetQueryObjectuiv(occlusion_queries_[2 * i + 1], GL_QUERY_RESULT, &number_pixels_one_instance_only);
 
         // instance2color map contains all instances for the scene and not all instances for this frame.
         // Thus, some instances are not visible in the current frame or frame-enlargement. 
@@ -402,8 +487,8 @@ void Renderer::CalcOcclusions(std::map<int, unsigned long>& instances2color, std
         const bool valid_instance = number_pixels_original > 0 && number_pixels_one_instance_only > 0; 
 
         if(valid_instance){
-            instances2occlusion[instance_id] = Renderer::VisibilityEntry(static_cast<float>(number_pixels_original),
-                                                                            static_cast<float>(number_pixels_one_instance_only));
+            instances2occlusion[visible[i]] = Renderer::VisibilityEntry(static_cast<float>(number_pixels_original),
+                                                                          static_cast<float>(number_pixels_one_instance_only));
         }
     }
 }
@@ -432,20 +517,115 @@ void Renderer::VerifyTruncationAndOcclusion(std::map<int, Renderer::VisibilityEn
     assert(rio_data_.instances2truncation.size() == rio_data_.instances2occlusion.size());
 }
 
+void Renderer::ClearFrameData() {
+    // Clear frame-specific data to be re-evaluated in the next render pass for the next frame.
+    rio_data_.bboxes.clear();
+    rio_data_.instances2truncation.clear();
+    rio_data_.instances2occlusion.clear();
+    
+    // These would not really need to be cleared because currently we save all instances of the scene in each Render pass and not all instances of the scene that are visible only in the current frame.
+    // rio_data_.instance2label.clear();
+    // rio_data_.instance2color.clear();
+    // rio_data_.color2instances.clear();
+}
+
 void Renderer::RenderAllFrames(const std::string save_path) {
     data_.SetFrame(0);
-    while (data_.HasNextFrame()){    
-        Render(true, save_path);
-        // Clear frame-specific data to be re-evaluated in the next render pass for the next frame.
-        rio_data_.bboxes.clear();
-        rio_data_.instances2truncation.clear();
-        rio_data_.instances2occlusion.clear();
-        
-        // These would not really need to be cleared because currently we save all instances of the scene in each Render pass and not all instances of the scene that are visible only in the current frame.
-        // rio_data_.instance2label.clear();
-        // rio_data_.instance2color.clear();
-        // rio_data_.color2instances.clear();
+    // The occlusion scores render every instance on its own and need the labels of a
+    // frame right away, so they are computed one frame after the other.
+    if (save_path == "" || save_occlusion_ || !(save_depth_ || save_images_ || save_bounding_boxes_)) {
+        if (!initalized_)
+            return;
+        while (data_.HasNextFrame()){    
+            RenderFrame(true, save_path);
+            ClearFrameData();
+        }
+        writer_->Wait();
+        return;
+    }
+    if (!initalized_)
+        return;
+    const bool labels = !rio_data_.color2instances.empty() || LoadObjects(data_path_ + "/objects.json");
+    const size_t pixels = buffer_width * buffer_height;
+    ReadbackRing ring(kReadbackSlots, { 3 * pixels, sizeof(unsigned short) * pixels,
+                                        3 * pixels, sizeof(unsigned short) * pixels });
+    std::vector<int> frame_ids(ring.slots(), 0);
+    StageTimes times;
+    // Waits for the transfers of a slot, converts and saves its frame. A frame whose
+    // buffers can not be mapped is skipped.
+    const auto finish = [&](const int slot) {
+        ring.Wait(slot);
+        times.Lap(StageTimes::Wait);
+        const bool copied = CopyReadback(ring, slot, labels);
+        times.Lap(StageTimes::Convert);
+        if (copied)
+            SaveFrame(FramePrefix(save_path, frame_ids[slot]));
+        else
+            RIO_LOG(Error) << "skipping frame " << frame_ids[slot];
+        ClearFrameData();
+        times.Lap(StageTimes::Save);
+    };
+    int frames = 0;
+    framebuffer_->Bind();
+    projection_ = Projection(data_.intrinsics);
+    while (data_.HasNextFrame()) {
+        const int slot = frames % ring.slots();
+        const auto read_labels = [&]() {
+            framebuffer_->ReadFrom(kLabelAttachment);
+            ring.Read(slot, kLabels, buffer_width, buffer_height, GL_BGR, GL_UNSIGNED_BYTE);
+            framebuffer_->ReadFrom(kInstanceAttachment);
+            ring.Read(slot, kInstances, buffer_width, buffer_height, GL_RED_INTEGER, GL_UNSIGNED_SHORT);
+        };
+        // Without a labeled mesh the labels need a draw of their own.
+        if (model_labels_ != nullptr && labels) {
+            DrawScene(*model_labels_, *shader_labels_);
+            times.Lap(StageTimes::Draw);
+            read_labels();
+            times.Lap(StageTimes::Read);
+        }
+        DrawScene(*model_RGB_, *shader_RGB_);
+        times.Lap(StageTimes::Draw);
+        if (model_labels_ == nullptr && labels)
+            read_labels();
+        framebuffer_->ReadFrom(kColorAttachment);
+        ring.Read(slot, kColor, buffer_width, buffer_height, GL_BGR, GL_UNSIGNED_BYTE);
+        framebuffer_->ReadFrom(kDepthAttachment);
+        ring.Read(slot, kDepth, buffer_width, buffer_height, GL_RED_INTEGER, GL_UNSIGNED_SHORT);
+        ring.Fence(slot);
+        times.Lap(StageTimes::Read);
+        frame_ids[slot] = data_.frame_id();
+        data_.NextFrame();
+        frames++;
+        // The oldest frame in flight had the whole last frame to finish its transfers.
+        const int oldest = frames % ring.slots();
+        if (ring.pending(oldest))
+            finish(oldest);
+    }
+    for (int i = 0; i < ring.slots(); i++) {
+        const int slot = (frames + i) % ring.slots();
+        if (ring.pending(slot))
+            finish(slot);
+    }
+    writer_->Wait();
+    times.Lap(StageTimes::Save);
+    times.Report(frames);
+}
+
+bool Renderer::CopyReadback(ReadbackRing& ring, const int slot, const bool labels) {
+    const auto copy = [&](const int image, const int type, cv::Mat& target) {
+        const void* data = ring.Map(slot, image);
+        if (data == nullptr)
+            return false;
+        CopyImage(data, buffer_height, buffer_width, type, target);
+        ring.Unmap(slot, image);
+        return true;
+    };
+    if (labels) {
+        if (!copy(kLabels, CV_8UC3, rio_data_.labels) || !copy(kInstances, CV_16UC1, rio_data_.instances))
+            return false;
+        UpdateBoundingBoxes(rio_data_.instances);
     }
+    return copy(kColor, CV_8UC3, rio_data_.color) && copy(kDepth, CV_16UC1, rio_data_.depth);
 }
 
 }; // namespace RIO